@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+
+namespace EventTimings {
+
+/// Clock used to timestamp all events, with a source that can be chosen at runtime.
+/** The clock satisfies the requirements of a std::chrono clock. All sources count nanoseconds
+since the epoch of std::chrono::steady_clock, hence time points of different sources are comparable. */
+class Clock
+{
+public:
+  using duration = std::chrono::nanoseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::time_point<Clock>;
+
+  static constexpr bool is_steady = true;
+
+  enum class Source : int {
+    /// std::chrono::steady_clock, the default
+    STEADY = 0,
+    /// Time stamp counter of x86 CPUs, calibrated against the steady clock. Requires an invariant TSC.
+    TSC = 1,
+    /// CLOCK_MONOTONIC_COARSE of Linux, cheap but only with a resolution of a few milliseconds.
+    COARSE = 2
+  };
+
+  /// Returns the current time from the selected source
+  static time_point now() noexcept
+  {
+    switch (source) {
+    case Source::TSC: {
+      // Signed, the TSC of another core may be slightly behind the base
+      auto const ticks = static_cast<std::int64_t>(readTSC()) - static_cast<std::int64_t>(tscTicksBase);
+      return time_point(duration(tscBase + static_cast<rep>(ticks * tscNsPerTick)));
+    }
+    case Source::COARSE:
+      return readCoarse();
+    default:
+      return time_point(std::chrono::steady_clock::now().time_since_epoch());
+    }
+  }
+
+  /// Selects the source of time stamps and calibrates it, if necessary.
+  /** Falls back to the steady clock if the source is not available on this system.
+      Only change the source before any event is recorded, as time points of different sources
+      can differ by the calibration error.
+      @returns the source that is actually used. */
+  static Source setSource(Source newSource);
+
+  static Source getSource();
+
+  /// Returns whether the CPU has an invariant time stamp counter, i.e., with a constant rate
+  static bool hasInvariantTSC();
+
+private:
+  static std::uint64_t readTSC() noexcept
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return 0;
+#endif
+  }
+
+  static time_point readCoarse() noexcept
+  {
+#ifdef CLOCK_MONOTONIC_COARSE
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return time_point(duration(static_cast<rep>(ts.tv_sec) * 1000000000 + ts.tv_nsec));
+#else
+    return time_point(std::chrono::steady_clock::now().time_since_epoch());
+#endif
+  }
+
+  /// Measures the rate of the time stamp counter against the steady clock
+  static void calibrateTSC();
+
+  static Source source;
+
+  /// Calibration of the TSC: steady time in ns at tscTicksBase and the length of a tick
+  static rep tscBase;
+  static std::uint64_t tscTicksBase;
+  static double tscNsPerTick;
+};
+
+}
@@ -1,38 +1,154 @@
 #pragma once
 
+#include "EventTimings/Clock.hpp"
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <map>
 
 namespace EventTimings {
 
-/// Represents an event that can be started and stopped.
-/** Additionally to the duration there is a special property that can be set for a event.
-A property is a a key-value pair with a numerical value that can be used to trace certain events,
-like MPI calls in an event. It is intended to be set by the user. */
-class Event
-{
-public:
+/// Compact handle of an interned event name, see EventRegistry::registerEvent
+using EventID = int;
 
+/// Types of an Event, shared by enabled and disabled events
+struct EventTypes
+{
   enum class State : int {
     STOPPED = 0,
     STARTED = 1,
     PAUSED  = 2,
   };
 
+  /// What is recorded of an event, see EventRegistry::setRecording
+  enum class Recording : int {
+    /// Nothing, the event is disabled
+    OFF       = 0,
+    /// Only aggregated data, i.e., count, durations and their histogram, no state changes
+    AGGREGATE = 1,
+    /// Aggregated data and all state changes
+    TRACE     = 2,
+  };
+
   /// Default clock type. All other chrono types are derived from it.
-  using Clock = std::chrono::steady_clock;
+  using Clock = EventTimings::Clock;
+
+  /// A change of state of an event, recorded by the thread with the given index
+  struct StateChange
+  {
+    State state;
+    Clock::time_point timestamp;
+    int thread;
+    EventID id;
+  };
+
+  using StateChanges = std::vector<StateChange>;
+
+  /// Type of the values attached to an event under a key
+  enum class DataType : int {
+    INT    = 0,
+    INT64  = 1,
+    DOUBLE = 2,
+  };
+
+  /// Values of one type attached under a key, integers are stored as 64 bit.
+  /** Adding a value of a wider type converts the values, i.e., INT < INT64 < DOUBLE. */
+  struct DataValues
+  {
+    DataType type = DataType::INT;
+    std::vector<std::int64_t> integers;
+    std::vector<double> reals;
+
+    void push(int value);
+    void push(std::int64_t value);
+    void push(double value);
+
+    /// Appends all values of other, converting to the wider type
+    void append(DataValues const & other);
+
+    /// Returns the value at index as a double
+    double get(std::size_t index) const;
+
+    std::size_t size() const;
 
-  using StateChanges = std::vector<std::pair<State, Clock::time_point>>;
+    void clear();
 
-  using Data = std::map<std::string, std::vector<int>>;
+  private:
+    /// Converts the values to type, if it's wider than the current type
+    void widen(DataType type);
+  };
+
+  using Data = std::map<std::string, DataValues>;
+};
+
+/// Copy of the recordings of all events for the calling thread, see EventRegistry::getRecording.
+/** Makes the check of the recording at the construction of an event an inline lookup without a lock.
+The copy is refreshed from the EventRegistry when an event is unknown to it or a setting changed. */
+class RecordingTable
+{
+public:
+  /// Returns what is recorded of a registered event, taking its level into account
+  static EventTypes::Recording get(EventID id)
+  {
+    auto const & copy = local();
+    if (static_cast<std::size_t>(id) < copy.size and copy.version == settingsVersion.load(std::memory_order_acquire))
+      return copy.recordings[id];
+    return refresh(id);
+  }
+
+private:
+  friend class EventRegistry;
+
+  /// The copy of a thread, which refresh owns
+  struct Copy
+  {
+    EventTypes::Recording const * recordings;
+    std::size_t size;
+    /// Value of settingsVersion when the copy was made
+    int version;
+  };
+
+  /// Returns the copy of the calling thread.
+  /** A trivial local thread_local is accessed directly, without the wrapper function of a static member. */
+  static Copy & local()
+  {
+    static thread_local Copy copy{nullptr, 0, -1};
+    return copy;
+  }
+
+  /// Copies the recordings of all events from the EventRegistry, defined in EventUtils.cpp
+  static EventTypes::Recording refresh(EventID id);
+
+  /// Incremented by the EventRegistry on each change of a level or recording
+  static std::atomic<int> settingsVersion;
+};
+
+#ifndef EVENTTIMINGS_DISABLED
+
+/// Represents an event that can be started and stopped.
+/** Additionally to the duration there is a special property that can be set for a event.
+A property is a a key-value pair with a numerical value that can be used to trace certain events,
+like MPI calls in an event. It is intended to be set by the user. */
+class Event : public EventTypes
+{
+public:
 
   /// An Event can't be copied.
   Event(const Event & other) = delete;
 
-  /// Name used to identify the timer. Events of the same name are accumulated to
-  std::string name;
+  /// Handle of the name used to identify the timer. Events of the same name are accumulated to
+  EventID id;
+
+private:
+
+  /// What is recorded of the event, determined at construction
+  /** Initialized before the other members, so that the compiler knows all stores to a disabled event
+   *  and can drop them together with the event. */
+  Recording recording;
+
+public:
 
   /// Allows to put a non-measured (i.e. with a given duration) Event to the measurements.
   Event(std::string eventName, Clock::duration initialDuration);
@@ -41,27 +157,67 @@ public:
   /** Use barrier == true with caution, as it can lead to deadlocks. */
   Event(std::string eventName, bool barrier = false, bool autostart = true);
 
+  /// Creates a new event from an already registered name, the prefix is not applied.
+  /** This avoids the lookup of the name and should be preferred for frequently created events.
+   *  Inline, so that creating a disabled event costs a lookup in the RecordingTable and a branch. */
+  Event(EventID eventID, bool barrier = false, bool autostart = true)
+    : id(eventID),
+      // Workaround to omit data lock: the global event is created from the EventRegistry ctor and always traced
+      recording(eventID == 0 ? Recording::TRACE : RecordingTable::get(eventID)),
+      _barrier(barrier)
+  {
+    if (autostart)
+      start(_barrier);
+  }
+
   /// Stops the event if it's running and report its times to the EventRegistry
-  ~Event();
+  ~Event()
+  {
+    if (recording != Recording::OFF)
+      stop(_barrier);
+  }
 
-  /// Starts an event. If it's already started it has no effect.
-  void start(bool barrier = false);
+  /// Starts an event. If it's already started or disabled it has no effect.
+  void start(bool barrier = false)
+  {
+    if (recording != Recording::OFF)
+      recordStart(barrier);
+  }
 
   /// Stops an event and commit it. If it's already stopped it has no effect.
-  void stop(bool barrier = false);
+  void stop(bool barrier = false)
+  {
+    if (state == State::STARTED or state == State::PAUSED)
+      recordStop(barrier);
+  }
 
   /// Pauses an event, does not commit. If it's already paused it has no effect.
-  void pause(bool barrier = false);
+  void pause(bool barrier = false)
+  {
+    if (state == State::STARTED)
+      recordPause(barrier);
+  }
+
+  /// Gets the full name, i.e., including the prefix, of the event.
+  std::string getName() const;
 
   /// Gets the duration of the event.
   Clock::duration getDuration() const;
 
-  /// Adds named integer data, associated to an event.
+  /// Adds named data, associated to an event.
+  /** Values of a key are stored, unless the key is marked by EventRegistry::setSummaryOnly. */
   void addData(std::string key, int value);
 
+  /// Adds named 64 bit integer data, e.g., byte counts, associated to an event.
+  void addData(std::string key, std::int64_t value);
+
+  /// Adds named floating point data, e.g., residuals, associated to an event.
+  void addData(std::string key, double value);
+
+  /// Returns whether the event is recorded, see EventRegistry::setLevel and EventRegistry::setRecording
+  bool isEnabled() const;
+
   Data data;
-  
-  StateChanges stateChanges;
 
 private:
 
@@ -69,6 +225,11 @@ private:
   Clock::duration duration = Clock::duration::zero();
   State state = State::STOPPED;
   bool _barrier = false;
+
+  /// The parts of start, stop and pause of an enabled event, out of line
+  void recordStart(bool barrier);
+  void recordStop(bool barrier);
+  void recordPause(bool barrier);
 };
 
 
@@ -86,4 +247,46 @@ private:
   std::string previousName = "";
 };
 
+#else
+
+/// Disabled event, all member functions are empty and inlined.
+/** Used if EVENTTIMINGS_DISABLED is defined. The constructors accept any arguments,
+so that no name needs to be constructed. */
+class Event : public EventTypes
+{
+public:
+
+  Event(const Event & other) = delete;
+
+  template<typename... Args>
+  Event(Args && ...) {}
+
+  void start(bool = false) {}
+
+  void stop(bool = false) {}
+
+  void pause(bool = false) {}
+
+  std::string getName() const { return ""; }
+
+  Clock::duration getDuration() const { return Clock::duration::zero(); }
+
+  template<typename T>
+  void addData(std::string const &, T) {}
+
+  bool isEnabled() const { return false; }
+};
+
+
+/// Disabled ScopedEventPrefix, does nothing.
+class ScopedEventPrefix
+{
+public:
+
+  template<typename T>
+  ScopedEventPrefix(T const &) {}
+};
+
+#endif
+
 }
@@ -1,55 +1,263 @@
 #pragma once
 
 #include "EventTimings/Event.hpp"
+#include "EventTimings/Histogram.hpp"
+#include <atomic>
 #include <chrono>
+#include <deque>
+#include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
 #include <vector>
 #include <string>
+#include <thread>
 #include <mpi.h>
 
 namespace EventTimings {
 
+class TraceSpill;
+
+struct NameTable;
+
+/// Online statistics of values, which can be merged without the values
+/** Mean and variance are updated by Welford's algorithm, merged by the algorithm of Chan et al. */
+struct DataSummary
+{
+  long count = 0;
+  double min = std::numeric_limits<double>::max();
+  double max = std::numeric_limits<double>::lowest();
+  double mean = 0;
+
+  /// Sum of squared differences from the mean
+  double m2 = 0;
+
+  void add(double value);
+
+  void merge(DataSummary const & other);
+
+  double getSum() const;
+
+  /// Returns the population variance
+  double getVariance() const;
+};
+
+/// Append-only, columnar storage of the data attached to all instances of an event.
+/** Each key has a column of values and, for each value, the index of the event instance it
+belongs to, i.e., the number of instances recorded before. Adding data never moves stored values.
+Columns of keys marked by EventRegistry::setSummaryOnly keep only a DataSummary of their values. */
+class DataStore
+{
+public:
+  struct Column
+  {
+    Event::DataValues values;
+
+    /// Index of the event instance of each value
+    std::vector<long> instances;
+
+    /// Whether only summary is kept, but no values and instances
+    bool summaryOnly = false;
+
+    DataSummary summary;
+  };
+
+  /// Appends the data of one event instance
+  void put(long instance, Event::Data const & data);
+
+  /// Appends a column to the column of key, shifting its instances by instanceOffset
+  void append(std::string const & key, Column const & column, long instanceOffset = 0);
+
+  /// Appends all columns of other, shifting their instances by instanceOffset
+  void merge(DataStore const & other, long instanceOffset);
+
+  /// Columns, sorted by key
+  std::map<std::string, Column> const & getColumns() const;
+
+  /// Returns the number of keys
+  std::size_t size() const;
+
+  void clear();
+
+private:
+  std::map<std::string, Column> columns;
+};
+
 /// Class that aggregates durations for a specific event.
 class EventData
 {
 public:
   explicit EventData(std::string _name);
 
-  EventData(std::string _name, long _count, long _total, long _max, long _min,
-            Event::Data data, Event::StateChanges stateChanges);
+  /// Creates aggregated data, all durations are given in nanoseconds
+  EventData(std::string _name, long _count, long _total, long _max, long _min, double _sumSquares,
+            DataStore data, Histogram histogram);
 
   /// Adds an Events data.
   void put(Event const & event);
 
-  std::string getName() const;
+  /// Adds aggregated data of the same event, e.g., recorded by another thread
+  void merge(EventData const & other);
 
-  /// Get the average duration of all events so far.
+  std::string const & getName() const;
+
+  /// Get the average duration in nanoseconds of all events so far.
   long getAvg() const;
 
-  /// Get the maximum duration of all events so far
+  /// Get the maximum duration in nanoseconds of all events so far
   long getMax() const;
 
-  /// Get the minimum duration of all events so far
+  /// Get the standard deviation of the durations in nanoseconds of all events so far
+  double getStdDev() const;
+
+  /// Get the minimum duration in nanoseconds of all events so far
   long getMin() const;
 
-  /// Get the total duration of all events so far
+  /// Get the total duration in nanoseconds of all events so far
   long getTotal() const;
 
   /// Get the number of all events so far
   long getCount() const;
 
-  Event::Data const & getData() const;
+  /// Get the duration in nanoseconds below which the given percentage of all events so far fall
+  long getPercentile(double percentage) const;
+
+  /// Data attached to all events so far, in the order they were recorded
+  DataStore const & getData() const;
+
+  /// Distribution of the durations of all events so far
+  Histogram const & getHistogram() const;
 
   Event::Clock::duration max = Event::Clock::duration::min();
   Event::Clock::duration min = Event::Clock::duration::max();
   Event::Clock::duration total = Event::Clock::duration::zero();
 
-  Event::StateChanges stateChanges;
+  /// Sum of the squared durations in nanoseconds, for the standard deviation
+  double sumSquares = 0;
 
 private:
   std::string name;
   long count = 0;
-  std::map<std::string, std::vector<int>> data;
+  DataStore data;
+  Histogram histogram;
+};
+
+/// Append-only storage of state changes.
+/** The state changes are stored in chunks of fixed size. A chunk is only allocated when the
+last one is full, chunks are kept for reuse on clear. Hence, pushing a state change does
+not allocate once warmed up. */
+class Timeline
+{
+public:
+  /// Number of state changes per chunk
+  static constexpr std::size_t chunkSize = 4096;
+
+private:
+  struct Chunk
+  {
+    std::size_t size = 0;
+    Event::StateChange records[chunkSize];
+  };
+
+  friend class TraceSpill;
+
+public:
+  /// Forward iterator over all state changes, in the order they were pushed.
+  template<typename Value>
+  class Iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Event::StateChange;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Value *;
+    using reference = Value &;
+
+    Iterator(std::unique_ptr<Chunk> const * chunk, std::size_t index)
+      : chunk(chunk), index(index)
+    {}
+
+    reference operator*() const { return (*chunk)->records[index]; }
+
+    pointer operator->() const { return &(*chunk)->records[index]; }
+
+    Iterator & operator++()
+    {
+      if (++index == (*chunk)->size) {
+        ++chunk;
+        index = 0;
+      }
+      return *this;
+    }
+
+    bool operator==(Iterator const & other) const { return chunk == other.chunk and index == other.index; }
+
+    bool operator!=(Iterator const & other) const { return not (*this == other); }
+
+  private:
+    std::unique_ptr<Chunk> const * chunk;
+    std::size_t index;
+  };
+
+  using iterator = Iterator<Event::StateChange>;
+  using const_iterator = Iterator<Event::StateChange const>;
+
+  /// Appends a state change
+  void push(Event::StateChange const & stateChange)
+  {
+    if (chunks.empty() or chunks.back()->size == chunkSize)
+      addChunk();
+    auto & chunk = *chunks.back();
+    chunk.records[chunk.size++] = stateChange;
+  }
+
+  /// Moves all state changes of other to the end, without copying them
+  void append(Timeline && other);
+
+  /// Removes all state changes, but keeps the chunks for reuse
+  void clear();
+
+  /// Removes all state changes and frees all chunks, including those kept for reuse
+  /** @returns the number of freed chunks */
+  std::size_t release();
+
+  /// Returns the number of state changes
+  std::size_t size() const;
+
+  bool empty() const { return chunks.empty(); }
+
+  /// Allocates chunks from the budget of spill, which writes full chunks to a file. Pass nullptr to detach.
+  /** The spilled state changes are not part of the timeline anymore, they need to be read back from spill. */
+  void setSpill(TraceSpill * spill);
+
+  iterator begin() { return {chunks.data(), 0}; }
+  iterator end() { return {chunks.data() + chunks.size(), 0}; }
+  const_iterator begin() const { return {chunks.data(), 0}; }
+  const_iterator end() const { return {chunks.data() + chunks.size(), 0}; }
+
+private:
+  /// Appends an empty chunk, reusing a free one if possible
+  void addChunk();
+
+  /// Chunks holding state changes, none of them is empty
+  std::vector<std::unique_ptr<Chunk>> chunks;
+
+  /// Cleared chunks, reused before allocating new ones
+  std::vector<std::unique_ptr<Chunk>> freeChunks;
+
+  TraceSpill * spill = nullptr;
+};
+
+/// Offset of the clock of a rank to the clock of a reference rank at some time
+struct ClockOffset
+{
+  /// Local time of the estimate
+  Event::Clock::time_point at;
+
+  /// Time of the reference clock minus the local time
+  Event::Clock::duration offset = Event::Clock::duration::zero();
 };
 
 /// Holds all EventData of one particular rank
@@ -66,17 +274,41 @@ public:
   /// Adds a new event
   void put(Event const & event);
 
-  /// Adds aggregated data for a specific event
+  /// Adds aggregated data for a specific event, the name is registered if necessary
   void addEventData(EventData ed);
 
-  /// Normalizes all Events to zero time of t0
-  void normalizeTo(std::chrono::system_clock::time_point t0);
+  /// Adds aggregated data for the event id of a name table of its own, which names the events up to id
+  /** Does not use the EventRegistry, e.g., for data read from a TraceFile. */
+  void addEventData(EventID id, EventData ed, std::vector<std::string> const & names);
+
+  /// Adds all EventData and moves all state changes of another RankData, e.g., recorded by another thread
+  void merge(RankData && other);
+
+  /// Returns the EventData of an event, creates it if necessary
+  EventData & getEventData(EventID id);
+
+  /// Returns all events that have been recorded at least once, sorted by name
+  std::vector<EventData const *> getEvents() const;
+
+  /// Normalizes all Events to zero time of t0, which is given on the reference clock
+  /** Local timestamps are converted to the reference clock by the offsets estimated at two times,
+   *  interpolated linearly to account for the drift of the clocks. */
+  void normalizeTo(Event::Clock::time_point t0, ClockOffset const & first, ClockOffset const & last);
+
+  /// Returns the time of initialize on the reference clock, given an offset estimated shortly after
+  Event::Clock::time_point getInitializedAt(ClockOffset const & offset) const;
+
+  /// Normalizes a timestamp that is not part of stateChanges as the last call of normalizeTo did
+  Event::Clock::time_point normalize(Event::Clock::time_point timestamp) const;
 
   /// Clears all Event data
   void clear();
 
-  /// Map of EventName -> EventData, should be private later
-  std::map<std::string, EventData> evData;
+  /// EventData indexed by EventID, should be private later
+  std::vector<EventData> evData;
+
+  /// State changes of all events, in the order they were recorded per thread
+  Timeline stateChanges;
 
   std::chrono::system_clock::duration getDuration() const;
 
@@ -84,8 +316,17 @@ public:
   std::chrono::system_clock::time_point finalizedAt;
   
 private:
-  std::chrono::steady_clock::time_point initializedAtTicks;
-  std::chrono::steady_clock::time_point finalizedAtTicks;
+  Event::Clock::time_point initializedAtTicks;
+  Event::Clock::time_point finalizedAtTicks;
+
+  /// Offset added to timestamps by normalizeTo at normalizationBase
+  Event::Clock::duration normalization = Event::Clock::duration::zero();
+
+  /// Local time at which normalization applies
+  Event::Clock::time_point normalizationBase;
+
+  /// Change of the offset per local time, the relative drift of the local clock
+  double drift = 0;
 
   bool isFinalized = true;
   int rank = 0;
@@ -98,13 +339,40 @@ struct GlobalEventStats
   int maxRank, minRank;
   Event::Clock::duration max   = Event::Clock::duration::min();
   Event::Clock::duration min   = Event::Clock::duration::max();
+
+  /// Number of events on all ranks
+  long count = 0;
+
+  /// Sum of the durations in nanoseconds on all ranks
+  long total = 0;
+
+  /// Sum of the squared durations in nanoseconds on all ranks
+  double sumSquares = 0;
+
+  /// Distribution of the durations on all ranks
+  Histogram histogram;
+
+  /// Summaries of the data of summary-only keys on all ranks
+  std::map<std::string, DataSummary> dataSummaries;
+
+  /// Get the duration in nanoseconds below which the given percentage of the events on all ranks fall
+  long getPercentile(double percentage) const;
+
+  /// Get the average duration in nanoseconds of the events on all ranks
+  long getAvg() const;
+
+  /// Get the standard deviation of the durations in nanoseconds of the events on all ranks
+  double getStdDev() const;
 };
 
 
 /// High level object that stores data of all events.
 /** Call EventRegistry::intialize at the beginning of your application and
 EventRegistry::finalize at the end. Event timings will be usuable without calling this
-function at all, but global timings as well as percentages do not work this way.  */
+function at all, but global timings as well as percentages do not work this way.
+
+Events can be used from multiple threads. Each thread records into its own shard,
+which are merged at finalize. All threads need to have stopped their events by then. */
 class EventRegistry
 {
 public:
@@ -114,6 +382,8 @@ public:
   /// Deleted assigment operator for singleton pattern
   void operator=(EventRegistry const &) = delete;
 
+  ~EventRegistry();
+
   /// Returns the only instance (singleton) of the EventRegistry class
   static EventRegistry & instance();
 
@@ -125,9 +395,43 @@ public:
    */
   void initialize(std::string applicationName = "", std::string runName = "", MPI_Comm comm = MPI_COMM_WORLD);
 
+  /// Selects the source of the clock for all events, takes effect at initialize.
+  /** The default can be set at compile time using EVENTTIMINGS_CLOCK. */
+  void setClockSource(Clock::Source source);
+
   /// Sets the global end time
   void finalize();
 
+  /// Sets the global end time like finalize, but completes the collective part in the background.
+  /** Stops all events and merges the data of this rank, then returns. Normalization, reduction and
+   *  gathering or writing run on a duplicate of the communicator by nonblocking MPI calls, which progress in
+   *  test and wait, or on a helper thread if MPI provides MPI_THREAD_MULTIPLE. Gather::NODES and
+   *  Gather::SHARED_FILE need blocking collectives, without the helper thread they run in wait.
+   *  Call no other methods of the registry before wait. Events with a barrier skip it meanwhile,
+   *  getMPIComm throws std::logic_error until then. */
+  void finalizeAsync();
+
+  /// Advances finalizeAsync without blocking, returns whether it completed. wait has to be called nevertheless.
+  /** Without MPI_THREAD_MULTIPLE, finalizeAsync only progresses in test and wait, so call it regularly, e.g.,
+   *  once per time step. The clock offsets of the ranks are estimated by messages answered here, hence
+   *  infrequent calls reduce the precision of the timestamps. */
+  bool test();
+
+  /// Completes finalizeAsync, must be called by all ranks before printAll and MPI_Finalize
+  void wait();
+
+  /// Returns whether finalizeAsync was called and wait was not yet, getMPIComm throws meanwhile
+  bool isFinalizingAsync() const;
+
+  /// Sets the minimum time between two checkpoints that write, 0 (the default) means every checkpoint writes
+  void setCheckpointInterval(double seconds);
+
+  /// Appends the state changes since the last checkpoint and the current timings of all ranks to appName-events.bin.
+  /** Collective, all threads need to have stopped their events, as at finalize. The written state changes are
+   *  removed from memory. With an interval set, a checkpoint only writes when rank 0 found the interval elapsed
+   *  at the previous checkpoint. This decision is broadcast without blocking, so other checkpoints are cheap. */
+  void checkpoint();
+
   /// Clears the registry. needed for tests
   void clear();
 
@@ -137,10 +441,96 @@ public:
   /// Records the event.
   void put(Event const & event);
 
+  /// Records a state change of an event, made by the calling thread.
+  void putStateChange(EventID id, Event::State state, Event::Clock::time_point timestamp);
+
+  /// Interns the event name and returns its handle. Registering a name twice returns the same handle.
+  /**
+   * The current prefix is not applied.
+   * @param[in] name Full name of the event
+   * @param[in] level Events are only recorded if their level is not above the level set by setLevel.
+   *                  The level is fixed by the first registration of a name.
+   */
+  EventID registerEvent(std::string const & name, int level = 0);
+
+  /// Sets the maximum level of events that are recorded, applies to newly created events only.
+  /** Events are registered with a level of 0 by default. Hence, a negative level disables all events. */
+  void setLevel(int maxLevel);
+
+  /// Sets what is recorded of all events without an own setting, applies to newly created events only.
+  /** The default is Event::Recording::TRACE. With Event::Recording::AGGREGATE no state changes are
+   *  recorded, which keeps the memory of long runs constant. */
+  void setRecording(Event::Recording recording);
+
+  /// Sets what is recorded of a single event, overriding the setting for all events.
+  void setRecording(EventID id, Event::Recording recording);
+
+  /// Returns what is recorded of an event, taking its level into account, see RecordingTable
+  Event::Recording getRecording(EventID id);
+
+  /// Marks a data key as summary-only, applies to all events.
+  /** Only the count, minimum, maximum, mean and variance of the values added under the key are kept,
+   *  not the values. Mark a key before any value is added under it. */
+  void setSummaryOnly(std::string const & key);
+
+  /// Returns whether a data key is summary-only
+  bool isSummaryOnly(std::string const & key) const;
+
+  /// What finalize gathers at rank 0 for writeJSON
+  enum class Gather {
+    /// Nothing, writeJSON has no ranks
+    NONE,
+    /// The data of all ranks including their state changes, the default
+    RANKS,
+    /// The data of all ranks of a shared memory node merged at its first rank, without state changes
+    NODES,
+    /// Nothing, instead each rank writes its data to appName-events.RANK.json at finalize,
+    /// rank 0 additionally an index of all files to appName-events.index.json
+    FILES,
+    /// Nothing, instead all ranks write their data collectively to a single binary appName-events.bin
+    /// using MPI-IO, see the README for its layout
+    SHARED_FILE,
+  };
+
+  /// Sets what finalize gathers at rank 0.
+  /** The gathered data is only needed for writeJSON. The global statistics of writeSummary are
+   *  reduced over all ranks in any case, which costs O(log P) instead of O(P) at rank 0. */
+  void setGather(Gather gather);
+
+  /// Trace that printAll writes in addition to the JSON output
+  enum class TraceFormat {
+    /// No trace, the default
+    NONE,
+    /// Trace Event Format of chrome://tracing and Perfetto, to appName-events.trace.json
+    CHROME,
+    /// Protobuf trace of Perfetto, to appName-events.pftrace, which is smaller and loads faster
+    PERFETTO,
+  };
+
+  /// Selects the trace that printAll writes from the state changes gathered at rank 0.
+  /** Only Gather::RANKS gathers state changes at rank 0. */
+  void setTraceFormat(TraceFormat format);
+
+  /// Limits the memory of state changes of this rank to about bytes, 0 (the default) means unlimited.
+  /** Must be called before initialize. When the limit is reached, a background thread writes state changes
+   *  to appName-events.RANK.spill, which is read back and removed at finalize. */
+  void setTraceBudget(std::size_t bytes);
+
+  /// Returns the name of a registered event
+  std::string const & getEventName(EventID id) const;
+
+  /// Returns a copy of the names of all registered events, indexed by EventID.
+  /** Writers of many state changes use it instead of locking the names for each getEventName. */
+  std::vector<std::string> getEventNames() const;
+
+  /// Returns the index of the calling thread, in order of their first recorded event
+  int getThreadID();
+
   /// Returns or creates a stored event, i.e., an event with life beyond the current scope
   Event & getStoredEvent(std::string const & name);
 
-  /// Prints a pretty report to stdout and a JSON report to appName-events.json
+  /// Prints a pretty report to stdout and a JSON report to appName-events.json and the trace
+  /// selected by setTraceFormat, unless Gather::FILES or Gather::SHARED_FILE is set
   void printAll();
 
   /// Prints the result table to an arbitrary stream, only prints at rank 0.
@@ -148,32 +538,170 @@ public:
 
   /// Writes the aggregated timings and state changes at JSON, only at rank 0.
   void writeJSON(std::ostream & out);
+
+  /// Writes the state changes in the Trace Event Format, only at rank 0.
+  /** A start and the following stop or pause of an event on a thread form a complete event.
+   *  Each thread of each rank is a thread of the process pid, which identifies the participant, with the
+   *  tid rank + thread * 2^20 as in the output of events2trace.
+   *  Timestamps are relative to the first initialized rank, which is given in otherData. */
+  void writeTrace(std::ostream & out, int pid = 0);
+
+  /// Writes the state changes as a Perfetto trace of TracePacket protobuf messages, only at rank 0.
+  /** Each thread of each rank is a track of the process pid, as in writeTrace. Event names are interned
+   *  and timestamps are differences to the previous event of a thread. Open out in binary mode. */
+  void writePerfetto(std::ostream & out, int pid = 0);
   
+  /// Returns the communicator of initialize, throws std::logic_error between finalizeAsync and wait
   MPI_Comm const & getMPIComm() const;
 
-  /// Currently active prefix. Changing that applies only to newly created events.
-  std::string prefix;
+  /// Currently active prefix of the calling thread. Changing that applies only to newly created events.
+  static thread_local std::string prefix;
 
   /// A name that is added to the logfile to identify a run
   std::string runName;
 
 private:
-  /// Private, empty constructor for singleton pattern
-  EventRegistry()
-    : globalEvent("_GLOBAL", true, false) // Unstarted, it's started in initialize
-  {}
+  /// Private constructor for singleton pattern
+  EventRegistry();
+
+  /// Recording storage of a single thread
+  struct ThreadShard;
+
+  /// Shard of the calling thread, created on its first recorded event
+  static thread_local ThreadShard * localShard;
+
+  /// Returns the shard of the calling thread, creates it on first use
+  ThreadShard & getShard();
+
+  /// Merges the data of all thread shards into localRankData and clears the shards.
+  void mergeShards();
+
+  /// Map of EventName -> EventID of all registered events
+  std::unordered_map<std::string, EventID> eventIDs;
+
+  /// Names of all registered events, indexed by EventID. A deque keeps references valid on growth.
+  std::deque<std::string> eventNames;
+
+  /// Levels of all registered events, indexed by EventID
+  std::vector<int> eventLevels;
+
+  /// Recording of events set by setRecording(EventID, Event::Recording), indexed by EventID, -1 if not set
+  std::vector<int> eventRecordings;
+
+  /// Maximum level of events that are recorded
+  int maxLevel = 0;
+
+  /// Recording of events without an own setting
+  Event::Recording defaultRecording = Event::Recording::TRACE;
 
+  /// Data keys marked by setSummaryOnly
+  std::set<std::string> summaryKeys;
+
+  /// Reads the levels and recordings under namesMutex
+  friend class RecordingTable;
+
+  /// Guards eventIDs, eventNames, eventLevels, eventRecordings, maxLevel, defaultRecording and summaryKeys
+  mutable std::mutex namesMutex;
+
+  /// Shards of all threads that have recorded events, indexed by thread id
+  std::vector<std::unique_ptr<ThreadShard>> shards;
+
+  /// Guards creation of shards
+  std::mutex shardsMutex;
+
+  /// Memory limit of state changes in bytes, 0 means unlimited
+  std::size_t traceBudget = 0;
+
+  /// Writes state changes beyond traceBudget to disk, exists between initialize and finalize
+  std::unique_ptr<TraceSpill> traceSpill;
+
+  /// Holds data of this rank, merged from all thread shards at finalize
   RankData localRankData;
 
-  /// Holds RankData from all ranks, only populated at rank 0
+  /// Holds RankData from all ranks or nodes, see setGather, only populated at rank 0
   std::vector<RankData> globalRankData;
 
-  /// Gather EventData from all ranks on rank 0.
-  void collect();
+  /// What finalize gathers into globalRankData
+  Gather gather = Gather::RANKS;
+
+  /// Trace written by printAll
+  TraceFormat traceFormat = TraceFormat::NONE;
+
+  /// Statistics of all events reduced over all ranks, indexed by name, only populated at rank 0
+  std::map<std::string, GlobalEventStats> globalStats;
+
+  /// Stops all events and merges the thread shards, the part of finalize local to this rank
+  void finalizeLocal();
+
+  /// Normalizes, reduces and gathers or writes the data, the part of finalize that needs all ranks
+  class CollectiveFinalize;
+
+  /// The CollectiveFinalize of finalizeAsync, which progresses in test and wait, or on finalizing
+  std::unique_ptr<CollectiveFinalize> asyncFinalize;
+
+  /// Completes asyncFinalize if MPI provides MPI_THREAD_MULTIPLE
+  std::thread finalizing;
+
+  /// Whether finalizing completed asyncFinalize
+  std::atomic<bool> finalizingDone{false};
+
+  /// Whether finalizeAsync was called and wait was not yet, guards getMPIComm against use of comm meanwhile
+  std::atomic<bool> asyncPending{false};
+
+  /// The communicator of initialize, while finalizing uses a duplicate of it as comm
+  MPI_Comm userComm = MPI_COMM_NULL;
+
+  /// Minimum seconds between two writing checkpoints
+  double checkpointInterval = 0;
+
+  /// Whether the next checkpoint writes, decided by rank 0 at the previous one
+  int checkpointDecision = 0;
+
+  /// Broadcast of checkpointDecision, MPI_REQUEST_NULL if none is pending
+  MPI_Request checkpointRequest = MPI_REQUEST_NULL;
+
+  /// Time of the last writing checkpoint, only used at rank 0
+  std::chrono::steady_clock::time_point lastCheckpoint;
+
+  /// Bytes of appName-events.bin written by checkpoints and Gather::SHARED_FILE, the next segment starts there
+  std::uint64_t sharedFileSize = 0;
+
+  /// Returns the names of the events of this rank, including those that only changed their state
+  std::vector<std::string> getRecordedNames();
+
+  /// Agrees on a table of the names of all events of all ranks, including those that only changed their state.
+  /** Collective, the table identifies the events in the Reduction, the gathering and writeSharedFile. */
+  NameTable agreeOnEventNames();
+
+  /// Reduces the statistics of all events over all ranks into globalStats at rank 0.
+  class Reduction;
+
+  /// Gathers the EventData of all ranks of each shared memory node merged at its first rank on rank 0.
+  /** Gather::RANKS is part of CollectiveFinalize, as it needs no blocking collectives. */
+  void collectNodes(NameTable const & names);
+
+  /// Writes the data of each rank to a file of its own and an index at rank 0, see Gather::FILES
+  void writeFiles();
+
+  /// Appends a segment with the data of all ranks collectively to a single file, see Gather::SHARED_FILE
+  void writeSharedFile(NameTable const & names);
+
+  /// Serializes the data of this rank for the gathering and writeSharedFile.
+  /** @param[in] names The table of agreeOnEventNames, events are packed with their index in it
+   *  @param[in] withStateChanges Whether the state changes are packed or an empty list instead */
+  std::vector<char> packRankData(NameTable const & names, bool withStateChanges);
 
   /// Normalize times among all ranks
+  /** Estimates the current offset of the clock of each rank to rank 0 and converts the timestamps
+   *  by the line through it and the offset estimated at initialize. */
+  class Normalization;
+
+  /// Runs a Normalization
   void normalize();
 
+  /// Offset of the clock of this rank to rank 0, estimated at initialize
+  ClockOffset initialOffset;
+
   /// Collects first initialize and last finalize time at rank 0.
   std::pair<std::chrono::system_clock::time_point, std::chrono::system_clock::time_point> collectInitAndFinalize();
 
@@ -190,9 +718,15 @@ private:
 
   std::map<std::string, Event> storedEvents;
 
+  /// Guards storedEvents
+  std::mutex storedEventsMutex;
+
   /// A name that is added to the logfile to distinguish different participants
   std::string applicationName;
 
+  /// Clock source that is selected at initialize
+  Clock::Source clockSource;
+
   /// MPI Communicator
   MPI_Comm comm;
 };
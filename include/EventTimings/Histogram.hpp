@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace EventTimings {
+
+/// Histogram of durations with logarithmically sized buckets.
+/** Every power of two is divided into subBuckets buckets of equal width, hence the relative
+error of a value taken from the histogram is below 1/subBuckets. Only the range of buckets between
+the smallest and the largest value is stored, which is bounded by the total number of buckets.
+Adding a value reserves memory for all buckets at once, so that recording does not allocate
+afterwards. Histograms can be merged, e.g., from different threads or ranks. */
+class Histogram
+{
+public:
+  /// Number of buckets per power of two
+  static constexpr int subBuckets = 8;
+
+  /// Largest power of two covered by the buckets, larger values are put into the last bucket
+  static constexpr int maxExponent = 50;
+
+  /// Total number of buckets
+  static constexpr int buckets = (maxExponent - 1) * subBuckets;
+
+  /// Adds a value, i.e., a duration in nanoseconds
+  void add(long value)
+  {
+    int const index = getBucketIndex(value);
+    if (index < offset or index >= offset + static_cast<int>(counts.size())) {
+      counts.reserve(buckets);
+      grow(index);
+    }
+    ++counts[index - offset];
+  }
+
+  /// Adds count values to the bucket with the given index
+  void add(int index, std::uint64_t count);
+
+  /// Adds all values of another histogram
+  void merge(Histogram const & other);
+
+  /// Returns the number of values in the histogram
+  std::uint64_t getCount() const;
+
+  /// Returns the value below which the given percentage of values fall.
+  /** The value is the midpoint of the bucket containing the percentile. Returns 0 for an empty histogram.
+      @param[in] percentage Percentage in the range [0, 100] */
+  long getPercentile(double percentage) const;
+
+  /// Returns all non-empty buckets as pairs of index and count
+  std::vector<std::pair<int, std::uint64_t>> getBuckets() const;
+
+  /// Removes all values
+  void clear();
+
+  /// Returns the index of the bucket a value belongs to
+  static int getBucketIndex(long value)
+  {
+    if (value < subBuckets)
+      return value < 0 ? 0 : static_cast<int>(value);
+    int const exponent = 63 - __builtin_clzll(static_cast<unsigned long long>(value));
+    if (exponent > maxExponent)
+      return buckets - 1;
+    int const shift = exponent - subBucketBits;
+    return (exponent - subBucketBits + 1) * subBuckets + static_cast<int>((value >> shift) & (subBuckets - 1));
+  }
+
+  /// Returns the smallest value of a bucket
+  static long getBucketLowerBound(int index);
+
+  /// Returns the smallest value of the next bucket
+  static long getBucketUpperBound(int index);
+
+private:
+  /// Number of bits to index the sub buckets
+  static constexpr int subBucketBits = 3;
+
+  static_assert(1 << subBucketBits == subBuckets, "subBuckets must be 2^subBucketBits");
+
+  /// Extends the stored range of buckets to include the given index
+  void grow(int index);
+
+  /// Index of the bucket stored at counts[0]
+  int offset = 0;
+
+  /// Counts of the buckets offset to offset + counts.size()
+  std::vector<std::uint64_t> counts;
+};
+
+}
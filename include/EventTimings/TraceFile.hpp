@@ -0,0 +1,139 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "EventTimings/Event.hpp"
+#include "EventTimings/EventUtils.hpp"
+
+namespace EventTimings {
+
+/// Reads the binary file written by Gather::SHARED_FILE and checkpoints, see the README for its layout.
+/** The file is mapped into memory. Opening it reads only the headers and name tables of its segments,
+the state changes are read from the mapping while iterating over them. The file has to be written on
+the same architecture. */
+class TraceFile
+{
+public:
+  /// State changes of a section, read from the mapping one at a time
+  class StateChanges
+  {
+  public:
+    /// Bytes of a record: the timestamp as int64, the id, thread and state as int32
+    static constexpr std::size_t recordSize = 20;
+
+    class iterator
+    {
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = Event::StateChange;
+      using difference_type = std::ptrdiff_t;
+      using pointer = Event::StateChange const *;
+      using reference = Event::StateChange;
+
+      explicit iterator(char const * pos)
+        : pos(pos)
+      {}
+
+      /// Unpacks the record, as it may not be aligned in the file
+      Event::StateChange operator*() const;
+
+      iterator & operator++()
+      {
+        pos += recordSize;
+        return *this;
+      }
+
+      bool operator==(iterator const & other) const { return pos == other.pos; }
+
+      bool operator!=(iterator const & other) const { return pos != other.pos; }
+
+    private:
+      char const * pos;
+    };
+
+    StateChanges(char const * begin, std::size_t count)
+      : first(begin), count(count)
+    {}
+
+    iterator begin() const { return iterator(first); }
+    iterator end() const { return iterator(first + count * recordSize); }
+    std::size_t size() const { return count; }
+
+  private:
+    char const * first;
+    std::size_t count;
+  };
+
+  /// The data of one rank in a segment
+  struct Section
+  {
+    std::chrono::system_clock::time_point initializedAt;
+
+    /// Time of finalize, or of the checkpoint that wrote the segment
+    std::chrono::system_clock::time_point finalizedAt;
+
+    /// State changes, identified by their index in the names of the segment.
+    /** Timestamps are normalized, i.e. nanoseconds since the first initialize of all ranks. */
+    StateChanges stateChanges;
+
+    /// The packed data, see EventRegistry::packRankData
+    char const * begin;
+    char const * end;
+  };
+
+  /// Data of all ranks written at once, the file holds one segment per writing checkpoint and finalize
+  struct Segment
+  {
+    std::string runName;
+
+    /// Names of all events, in the order of their index
+    std::vector<std::string> names;
+
+    /// Data of each rank, indexed by rank
+    std::vector<Section> sections;
+  };
+
+  /// Maps the file and reads the headers of its segments, throws std::runtime_error if that fails
+  explicit TraceFile(std::string const & filename);
+
+  TraceFile(const TraceFile & other) = delete;
+  TraceFile & operator=(const TraceFile & other) = delete;
+
+  /// Unmaps the file
+  ~TraceFile();
+
+  std::vector<Segment> const & getSegments() const;
+
+  /// Returns the names of the events of all segments, indexed by the EventIDs of the RankData of load
+  std::vector<std::string> const & getNames() const;
+
+  /// Returns the number of ranks, which is the same in all segments
+  int getRanks() const;
+
+  /// Unpacks the data of a rank from all segments, its events are identified by their index in getNames.
+  /** The timings are those of the last segment, as they are cumulative. The state changes of all
+   *  segments are concatenated. Throws std::runtime_error if the section is corrupt. */
+  RankData load(int rank) const;
+
+  /// Exports all ranks in the JSON format of EventRegistry::writeJSON
+  void writeJSON(std::ostream & out) const;
+
+private:
+  std::string filename;
+
+  char const * data = nullptr;
+  std::size_t size = 0;
+  std::vector<Segment> segments;
+
+  /// Names of the events of all segments, in the order of their first appearance
+  std::vector<std::string> names;
+
+  /// The index in names of each name of each segment
+  std::vector<std::vector<EventID>> localIDs;
+};
+
+}
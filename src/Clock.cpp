@@ -0,0 +1,68 @@
+#include "EventTimings/Clock.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace EventTimings {
+
+constexpr bool Clock::is_steady;
+
+Clock::Source Clock::source = Clock::Source::STEADY;
+
+Clock::rep Clock::tscBase = 0;
+std::uint64_t Clock::tscTicksBase = 0;
+double Clock::tscNsPerTick = 0;
+
+
+Clock::Source Clock::setSource(Source newSource)
+{
+  if (newSource == Source::TSC) {
+    if (hasInvariantTSC())
+      calibrateTSC();
+    else
+      newSource = Source::STEADY;
+  }
+#ifndef CLOCK_MONOTONIC_COARSE
+  if (newSource == Source::COARSE)
+    newSource = Source::STEADY;
+#endif
+  source = newSource;
+  return source;
+}
+
+Clock::Source Clock::getSource()
+{
+  return source;
+}
+
+bool Clock::hasInvariantTSC()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 or eax < 0x80000007)
+    return false;
+  __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+  return edx & (1u << 8);
+#else
+  return false;
+#endif
+}
+
+void Clock::calibrateTSC()
+{
+  using stdy_clk = std::chrono::steady_clock;
+  // Measures the ticks over 10ms. The reads are paired tightly, so that their offset cancels out.
+  auto const t0 = stdy_clk::now();
+  auto const ticks0 = readTSC();
+  auto t1 = stdy_clk::now();
+  while (t1 - t0 < std::chrono::milliseconds(10))
+    t1 = stdy_clk::now();
+  auto const ticks1 = readTSC();
+
+  tscNsPerTick = static_cast<double>(std::chrono::duration_cast<duration>(t1 - t0).count()) / (ticks1 - ticks0);
+  tscTicksBase = ticks1;
+  tscBase = std::chrono::duration_cast<duration>(t1.time_since_epoch()).count();
+}
+
+}
@@ -3,70 +3,152 @@
 
 namespace EventTimings  {
 
-Event::Event(std::string eventName, Clock::duration initialDuration)
-  : name(EventRegistry::instance().prefix + eventName),
-    duration(initialDuration)
+void EventTypes::DataValues::push(int value)
 {
-  EventRegistry::instance().put(*this);
+  if (type == DataType::DOUBLE)
+    reals.push_back(value);
+  else
+    integers.push_back(value);
 }
 
-Event::Event(std::string eventName, bool barrier, bool autostart)
-  : name(eventName),
-    _barrier(barrier)
-{
-  // Set prefix here: workaround to omit data lock between instance() and Event ctor
-  if (eventName != "_GLOBAL")
-    name = EventRegistry::instance().prefix + eventName;
-  if (autostart) {
-    start(_barrier);
+void EventTypes::DataValues::push(std::int64_t value)
+{
+  widen(DataType::INT64);
+  if (type == DataType::DOUBLE)
+    reals.push_back(value);
+  else
+    integers.push_back(value);
+}
+
+void EventTypes::DataValues::push(double value)
+{
+  widen(DataType::DOUBLE);
+  reals.push_back(value);
+}
+
+void EventTypes::DataValues::append(DataValues const & other)
+{
+  widen(other.type);
+  if (type == DataType::DOUBLE) {
+    reals.insert(reals.end(), other.reals.begin(), other.reals.end());
+    reals.insert(reals.end(), other.integers.begin(), other.integers.end());
+  }
+  else {
+    integers.insert(integers.end(), other.integers.begin(), other.integers.end());
+  }
+}
+
+double EventTypes::DataValues::get(std::size_t index) const
+{
+  return type == DataType::DOUBLE ? reals[index] : integers[index];
+}
+
+std::size_t EventTypes::DataValues::size() const
+{
+  return integers.size() + reals.size();
+}
+
+void EventTypes::DataValues::clear()
+{
+  integers.clear();
+  reals.clear();
+}
+
+void EventTypes::DataValues::widen(DataType type)
+{
+  if (type <= this->type)
+    return;
+
+  if (type == DataType::DOUBLE) {
+    reals.insert(reals.end(), integers.begin(), integers.end());
+    integers.clear();
   }
+  this->type = type;
 }
 
-Event::~Event()
+}
+
+#ifndef EVENTTIMINGS_DISABLED
+
+namespace EventTimings  {
+
+namespace {
+
+/// Registers the name with the prefix of the calling thread, without a copy if there is no prefix
+EventID registerPrefixed(std::string const & eventName)
 {
-  stop(_barrier);
+  auto & registry = EventRegistry::instance();
+  if (registry.prefix.empty())
+    return registry.registerEvent(eventName);
+  return registry.registerEvent(registry.prefix + eventName);
 }
 
-void Event::start(bool barrier)
+/// Synchronizes the ranks, unless the communicator is busy between finalizeAsync and wait
+void synchronize()
+{
+  auto & registry = EventRegistry::instance();
+  if (not registry.isFinalizingAsync())
+    MPI_Barrier(registry.getMPIComm());
+}
+
+}
+
+Event::Event(std::string eventName, Clock::duration initialDuration)
+  : id(registerPrefixed(eventName)),
+    recording(RecordingTable::get(id)),
+    duration(initialDuration)
+{
+  if (recording != Recording::OFF)
+    EventRegistry::instance().put(*this);
+}
+
+Event::Event(std::string eventName, bool barrier, bool autostart)
+  : Event(registerPrefixed(eventName), barrier, autostart)
+{}
+
+void Event::recordStart(bool barrier)
 {
   if (barrier)
-    MPI_Barrier(EventRegistry::instance().getMPIComm());
+    synchronize();
 
   state = State::STARTED;
-  stateChanges.push_back(std::make_pair(State::STARTED, Clock::now()));
   starttime = Clock::now();
+  if (recording == Recording::TRACE)
+    EventRegistry::instance().putStateChange(id, state, starttime);
 }
 
-void Event::stop(bool barrier)
+void Event::recordStop(bool barrier)
 {
-  if (state == State::STARTED or state == State::PAUSED) {
-    if (barrier)
-      MPI_Barrier(EventRegistry::instance().getMPIComm());
+  if (barrier)
+    synchronize();
 
-    if (state == State::STARTED) {
-      auto stoptime = Clock::now();
-      duration += Clock::duration(stoptime - starttime);
-    }
-    stateChanges.push_back(std::make_pair(State::STOPPED, Clock::now()));
-    state = State::STOPPED;
-    EventRegistry::instance().put(*this);
-    data.clear();
-    stateChanges.clear();
-    duration = Clock::duration::zero();
-  }
+  auto stoptime = Clock::now();
+  if (state == State::STARTED)
+    duration += Clock::duration(stoptime - starttime);
+
+  state = State::STOPPED;
+  if (recording == Recording::TRACE)
+    EventRegistry::instance().putStateChange(id, state, stoptime);
+  EventRegistry::instance().put(*this);
+  data.clear();
+  duration = Clock::duration::zero();
 }
 
-void Event::pause(bool barrier)
+void Event::recordPause(bool barrier)
 {
-  if (state == State::STARTED) {
-    if (barrier)
-      MPI_Barrier(EventRegistry::instance().getMPIComm());
+  if (barrier)
+    synchronize();
 
-    auto stoptime = Clock::now();
-    stateChanges.emplace_back(State::PAUSED, Clock::now());
-    state = State::PAUSED;
-    duration += Clock::duration(stoptime - starttime);
-  }
+  auto stoptime = Clock::now();
+  state = State::PAUSED;
+  if (recording == Recording::TRACE)
+    EventRegistry::instance().putStateChange(id, state, stoptime);
+  duration += Clock::duration(stoptime - starttime);
+}
+
+std::string Event::getName() const
+{
+  return EventRegistry::instance().getEventName(id);
 }
 
 Event::Clock::duration Event::getDuration() const
@@ -76,7 +158,25 @@ Event::Clock::duration Event::getDuration() const
 
 void Event::addData(std::string key, int value)
 {
-  data[key].push_back(value);
+  if (recording != Recording::OFF)
+    data[key].push(value);
+}
+
+void Event::addData(std::string key, std::int64_t value)
+{
+  if (recording != Recording::OFF)
+    data[key].push(value);
+}
+
+void Event::addData(std::string key, double value)
+{
+  if (recording != Recording::OFF)
+    data[key].push(value);
+}
+
+bool Event::isEnabled() const
+{
+  return recording != Recording::OFF;
 }
 
 // -----------------------------------------------------------------------
@@ -93,3 +193,5 @@ ScopedEventPrefix::~ScopedEventPrefix()
 }
 
 }
+
+#endif
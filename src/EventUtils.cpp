@@ -1,22 +1,36 @@
 #include "EventTimings/EventUtils.hpp"
-#include "json.hpp"
 
 #include <cassert>
+#include <cmath>
 #include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <numeric>
 #include <fstream>
 #include <string>
 #include <sstream>
+#include <stdexcept>
 #include <ctime>
 #include <utility>
 #include "prettyprint.hpp"
 #include "TableWriter.hpp"
+#include "JSONWriter.hpp"
+#include "PackBuffer.hpp"
+#include "ProtoWriter.hpp"
+#include "Serialization.hpp"
+#include "TraceConverter.hpp"
+#include "TraceSpill.hpp"
+
+#ifndef EVENTTIMINGS_CLOCK
+#define EVENTTIMINGS_CLOCK STEADY
+#endif
 
 namespace EventTimings {
 
 using sys_clk = std::chrono::system_clock;
-using stdy_clk = std::chrono::steady_clock;
+
+/// Maximum relative drift of the clocks of two ranks that is corrected
+constexpr double maxDrift = 1e-3;
 
 template<class... Args>
 void dbgprint(const std::string& format, Args&&... args)
@@ -37,7 +51,26 @@ template<typename A, typename B> double divOrZero(A a, B b)
     return a / b;
 }
 
-/// Converts the time_point into a string like "2019-01-10T18:30:46.834"
+/// Unit to print durations in
+struct DurationUnit
+{
+  std::string name;
+  double nanoseconds;
+};
+
+/// Selects the largest unit in which the given duration in nanoseconds is at least 1
+DurationUnit selectUnit(long maxNanoseconds)
+{
+  if (maxNanoseconds >= 1000000000)
+    return {"s", 1e9};
+  if (maxNanoseconds >= 1000000)
+    return {"ms", 1e6};
+  if (maxNanoseconds >= 1000)
+    return {"us", 1e3};
+  return {"ns", 1};
+}
+
+
 std::string timepoint_to_string(sys_clk::time_point c)
 {
   using namespace std::chrono;
@@ -50,210 +83,1869 @@ std::string timepoint_to_string(sys_clk::time_point c)
 }
 
 
-std::map<std::string, GlobalEventStats> getGlobalStats(std::vector<RankData> events)
-{
-  std::map<std::string, GlobalEventStats> globalStats;
-  for (size_t rank = 0; rank < events.size(); ++rank) {
-    for (auto & evData : events[rank].evData) {
-      auto const & event = evData.second;
-      GlobalEventStats & stats = globalStats[evData.first];
-      if (event.max > stats.max) {
-        stats.max = event.max;
-        stats.maxRank = rank;
-      }
-      if (event.min < stats.min) {
-        stats.min = event.min;
-        stats.minRank = rank;
-      }
-    }
-  }
-  return globalStats;
-}
+/// A collective operation of several steps, each step starts when the requests of the previous one completed.
+/** The requests are waited for if progress blocks, otherwise only tested. Hence, the same steps run blocking
+ *  in finalize and progress without blocking in EventRegistry::test after finalizeAsync. */
+class Collective
+{
+public:
+  virtual ~Collective() = default;
+
+  /// Runs all steps whose requests completed, waiting for them if block. Returns whether all steps completed.
+  bool progress(bool block)
+  {
+    while (true) {
+      if (block)
+        MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+      else {
+        int completed;
+        MPI_Testall(requests.size(), requests.data(), &completed, MPI_STATUSES_IGNORE);
+        if (not completed)
+          return false;
+      }
+      requests.clear();
+      if (finished)
+        return true;
+
+      auto const next = step(block);
+      if (next == Step::PENDING)
+        return false;
+      finished = next == Step::LAST;
+    }
+  }
+
+protected:
+  enum class Step {
+    /// The next step runs when the requests of this one completed
+    NEXT,
+    /// The step can not run without blocking yet and is retried at the next progress
+    PENDING,
+    /// The operation completes with the requests of this step
+    LAST,
+  };
+
+  /// Runs the next step, which may start requests. Returns PENDING only if not block.
+  virtual Step step(bool block) = 0;
+
+  /// Requests of the current step
+  std::vector<MPI_Request> requests;
+
+private:
+  bool finished = false;
+};
+
+
+/// Estimates the offset of the clock of each rank to the clock of rank 0 by ping-pong messages.
+/** Each rank asks rank 0 for its time several times and takes the answer of the fastest round trip,
+ *  assuming the answer was taken halfway. Rank 0 answers the ranks in the order their messages arrive.
+ *  A round trip ends when its answer is found, hence without blocking it is as precise as progress is frequent. */
+class ClockEstimation : public Collective
+{
+public:
+  explicit ClockEstimation(MPI_Comm comm)
+    : comm(comm)
+  {
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+  }
+
+  ClockOffset estimate;
+
+private:
+  static constexpr int rounds = 10;
+
+  MPI_Comm comm;
+  int rank, size;
+
+  /// A communicator of its own, such that no message of the application can match
+  MPI_Comm pingComm = MPI_COMM_NULL;
+
+  enum class Stage { DUPLICATE, ROUNDS, FREE } stage = Stage::DUPLICATE;
+
+  /// Rounds started by a rank other than 0
+  int round = 0;
+
+  /// Rounds answered by rank 0, indexed by rank - 1
+  std::vector<int> answered;
+
+  Event::Clock::time_point sent;
+  std::int64_t reference = 0;
+  Event::Clock::duration fastest = Event::Clock::duration::max();
+
+  /// Messages of the other ranks received by rank 0, indexed by rank - 1
+  std::vector<MPI_Request> pings;
+
+  /// Answers of rank 0, a deque keeps them in place while they are sent
+  std::deque<std::int64_t> answers;
+
+  Step step(bool block) override
+  {
+    switch (stage) {
+    case Stage::DUPLICATE:
+      estimate.at = Event::Clock::now();
+      requests.emplace_back();
+      MPI_Comm_idup(comm, &pingComm, &requests.back());
+      stage = Stage::ROUNDS;
+      return Step::NEXT;
+
+    case Stage::ROUNDS:
+      if (rank == 0)
+        return answer(block);
+      return ask();
+
+    case Stage::FREE:
+      MPI_Comm_free(&pingComm);
+      return Step::LAST;
+    }
+    return Step::LAST;
+  }
+
+  /// Evaluates the previous round trip of a rank other than 0 and starts the next one
+  Step ask()
+  {
+    if (round > 0) {
+      auto const received = Event::Clock::now();
+      if (received - sent < fastest) {
+        fastest = received - sent;
+        estimate.at = sent + fastest / 2;
+        estimate.offset = Event::Clock::duration(reference) - estimate.at.time_since_epoch();
+      }
+    }
+    if (round == rounds) {
+      stage = Stage::FREE;
+      return Step::NEXT;
+    }
+
+    ++round;
+    sent = Event::Clock::now();
+    requests.resize(2);
+    MPI_Isend(nullptr, 0, MPI_BYTE, 0, 0, pingComm, &requests[0]);
+    MPI_Irecv(&reference, 1, MPI_INT64_T, 0, 0, pingComm, &requests[1]);
+    return Step::NEXT;
+  }
+
+  /// Answers the messages of the other ranks that arrived at rank 0, until all rounds are answered
+  Step answer(bool block)
+  {
+    if (answered.empty()) {
+      answered.resize(size - 1);
+      pings.resize(size - 1);
+      for (int r = 1; r < size; ++r)
+        MPI_Irecv(nullptr, 0, MPI_BYTE, r, 0, pingComm, &pings[r - 1]);
+    }
+
+    // Completed pings become MPI_REQUEST_NULL, once all are, no index is returned
+    int arrived;
+    std::vector<int> indices(pings.size());
+    if (block)
+      MPI_Waitsome(pings.size(), pings.data(), &arrived, indices.data(), MPI_STATUSES_IGNORE);
+    else
+      MPI_Testsome(pings.size(), pings.data(), &arrived, indices.data(), MPI_STATUSES_IGNORE);
+    if (arrived == MPI_UNDEFINED) {
+      stage = Stage::FREE;
+      return Step::NEXT;
+    }
+    if (arrived == 0)
+      return Step::PENDING;
+
+    for (int i = 0; i < arrived; ++i) {
+      int const r = indices[i] + 1;
+      answers.push_back(Event::Clock::now().time_since_epoch().count());
+      requests.emplace_back();
+      MPI_Isend(&answers.back(), 1, MPI_INT64_T, r, 0, pingComm, &requests.back());
+      if (++answered[r - 1] < rounds)
+        MPI_Irecv(nullptr, 0, MPI_BYTE, r, 0, pingComm, &pings[r - 1]);
+    }
+    return Step::NEXT;
+  }
+};
+
+constexpr int ClockEstimation::rounds;
+
+/// Estimates the offset of the clock of each rank to the clock of rank 0, see ClockEstimation
+ClockOffset estimateClockOffset(MPI_Comm comm)
+{
+  ClockEstimation estimation(comm);
+  estimation.progress(true);
+  return estimation.estimate;
+}
+
+
+void writeRankJSON(JSONWriter & json, RankData const & rank, std::vector<std::string> const & names,
+                   std::function<void()> const & writeSpilled)
+{
+  using namespace std::chrono;
+
+  json.beginObject();
+  json.key("Finalized").value(timepoint_to_string(rank.finalizedAt));
+  json.key("Initialized").value(timepoint_to_string(rank.initializedAt));
+
+  json.key("Timings").beginObject();
+  double const duration = duration_cast<nanoseconds>(rank.getDuration()).count();
+  for (auto const * event : rank.getEvents()) {
+    auto const & e = *event;
+    json.key(e.getName()).beginObject();
+    json.key("Count").value(e.getCount());
+    json.key("Total").value(e.getTotal());
+    json.key("Max").value(e.getMax());
+    json.key("Min").value(e.getMin());
+    json.key("TimeRatio").value(divOrZero(e.getTotal(), duration));
+    json.key("Percentiles").beginObject();
+    json.key("50").value(e.getPercentile(50));
+    json.key("95").value(e.getPercentile(95));
+    json.key("99").value(e.getPercentile(99));
+    json.endObject();
+
+    json.key("Data").beginObject();
+    for (auto const & c : e.getData().getColumns()) {
+      auto const & column = c.second;
+      json.key(c.first);
+      if (column.summaryOnly) {
+        json.beginObject();
+        json.key("Count").value(column.summary.count);
+        json.key("Min").value(column.summary.min);
+        json.key("Max").value(column.summary.max);
+        json.key("Sum").value(column.summary.getSum());
+        json.key("Mean").value(column.summary.mean);
+        json.key("Variance").value(column.summary.getVariance());
+        json.endObject();
+      }
+      else if (column.values.type == Event::DataType::DOUBLE)
+        json.value(column.values.reals);
+      else
+        json.value(column.values.integers);
+    }
+    json.endObject();
+    json.endObject();
+  }
+  json.endObject();
+
+  json.key("StateChanges").beginArray();
+  if (writeSpilled)
+    writeSpilled();
+  for (auto const & sc : rank.stateChanges)
+    writeStateChangeJSON(json, sc, names);
+  json.endArray();
+  json.endObject();
+}
+
+void writeStateChangeJSON(JSONWriter & json, Event::StateChange const & sc, std::vector<std::string> const & names)
+{
+  json.beginObject();
+  json.key("Name").value(names[sc.id]);
+  json.key("State").value(static_cast<int>(sc.state));
+  json.key("Timestamp").value(sc.timestamp.time_since_epoch().count());
+  json.key("Thread").value(sc.thread);
+  json.endObject();
+}
+
+/// Writes an event of the Trace Event Format, timestamp and duration of a complete event in microseconds
+void writeTraceEvent(JSONWriter & json, char const * phase, std::string const & name, int pid, long tid,
+                     Event::Clock::time_point timestamp, Event::Clock::duration duration = {})
+{
+  using namespace std::chrono;
+
+  json.beginObject();
+  json.key("name").value(name);
+  json.key("ph").value(phase);
+  json.key("pid").value(pid);
+  json.key("tid").value(tid);
+  json.key("ts").value(duration_cast<nanoseconds>(timestamp.time_since_epoch()).count() / 1e3);
+  if (phase[0] == 'X')
+    json.key("dur").value(duration_cast<nanoseconds>(duration).count() / 1e3);
+  json.endObject();
+}
+
+/// Writes a metadata event of the Trace Event Format, which sets the argument key to value
+template<typename T>
+void writeTraceMetadata(JSONWriter & json, char const * name, int pid, long tid, char const * key, T const & value)
+{
+  json.beginObject();
+  json.key("name").value(name);
+  json.key("ph").value("M");
+  json.key("pid").value(pid);
+  json.key("tid").value(tid);
+  json.key("args").beginObject().key(key).value(value).endObject();
+  json.endObject();
+}
+
+/// Returns the name of the track of a thread of a rank
+std::string getThreadName(int rankIndex, int thread)
+{
+  std::string name = "Rank " + std::to_string(rankIndex);
+  if (thread > 0)
+    name += " thread " + std::to_string(thread);
+  return name;
+}
+
+void writeTraceEvents(JSONWriter & json, RankData const & rank, std::vector<std::string> const & names,
+                      int pid, int rankIndex)
+{
+  std::set<int> rankThreads;
+  for (auto const & sc : rank.stateChanges)
+    rankThreads.insert(sc.thread);
+  for (int thread : rankThreads) {
+    long const tid = getTraceTID(rankIndex, thread);
+    writeTraceMetadata(json, "thread_name", pid, tid, "name", getThreadName(rankIndex, thread));
+    writeTraceMetadata(json, "thread_sort_index", pid, tid, "sort_index", getTraceSortIndex(rankIndex, thread));
+  }
+
+  // Starts of the running events of each thread and event, a stop or pause ends the last one.
+  // A stop without a start follows a pause, which already ended the event.
+  std::unordered_map<std::uint64_t, std::vector<Event::Clock::time_point>> running;
+  for (auto const & sc : rank.stateChanges) {
+    long const tid = getTraceTID(rankIndex, sc.thread);
+    auto & starts = running[static_cast<std::uint64_t>(sc.thread) << 32 | static_cast<std::uint32_t>(sc.id)];
+    if (sc.state == Event::State::STARTED)
+      starts.push_back(sc.timestamp);
+    else if (not starts.empty()) {
+      writeTraceEvent(json, "X", names[sc.id], pid, tid, starts.back(), sc.timestamp - starts.back());
+      starts.pop_back();
+    }
+  }
+
+  // Events that were not stopped, e.g., before an abort
+  for (auto const & r : running) {
+    long const tid = getTraceTID(rankIndex, static_cast<long>(r.first >> 32));
+    auto const id = static_cast<EventID>(r.first & 0xffffffff);
+    for (auto const & start : r.second)
+      writeTraceEvent(json, "B", names[id], pid, tid, start);
+  }
+}
+
+/// Field numbers and values of the Perfetto protos, see protos/perfetto/trace in the Perfetto sources
+namespace perfetto {
+
+// Trace
+constexpr std::uint32_t packet = 1;
+
+// TracePacket
+constexpr std::uint32_t clockSnapshot = 6;
+constexpr std::uint32_t timestamp = 8;
+constexpr std::uint32_t sequenceID = 10;
+constexpr std::uint32_t trackEvent = 11;
+constexpr std::uint32_t internedData = 12;
+constexpr std::uint32_t sequenceFlags = 13;
+constexpr std::uint32_t timestampClockID = 58;
+constexpr std::uint32_t packetDefaults = 59;
+constexpr std::uint32_t trackDescriptor = 60;
+
+// TracePacket.SequenceFlags
+constexpr std::uint64_t incrementalStateCleared = 1;
+constexpr std::uint64_t needsIncrementalState = 2;
+
+// TracePacketDefaults and TrackEventDefaults
+constexpr std::uint32_t defaultClockID = 58;
+constexpr std::uint32_t trackEventDefaults = 11;
+constexpr std::uint32_t defaultTrackUUID = 11;
+
+// ClockSnapshot and ClockSnapshot.Clock
+constexpr std::uint32_t clocks = 1;
+constexpr std::uint32_t clockID = 1;
+constexpr std::uint32_t clockTimestamp = 2;
+constexpr std::uint32_t clockIncremental = 3;
+
+/// The default clock of traces
+constexpr std::uint64_t boottime = 6;
+
+/// Clock of a sequence whose timestamps are the difference to the previous packet, ids from 64 are per sequence
+constexpr std::uint64_t incrementalClock = 64;
+
+// TrackDescriptor, ProcessDescriptor and ThreadDescriptor
+constexpr std::uint32_t trackUUID = 1;
+constexpr std::uint32_t trackProcess = 3;
+constexpr std::uint32_t trackThread = 4;
+constexpr std::uint32_t trackParentUUID = 5;
+constexpr std::uint32_t processPID = 1;
+constexpr std::uint32_t processName = 6;
+constexpr std::uint32_t threadPID = 1;
+constexpr std::uint32_t threadTID = 2;
+constexpr std::uint32_t threadName = 5;
+
+// TrackEvent and TrackEvent.Type
+constexpr std::uint32_t eventType = 9;
+constexpr std::uint32_t eventNameIID = 10;
+constexpr std::uint64_t sliceBegin = 1;
+constexpr std::uint64_t sliceEnd = 2;
+
+// InternedData and EventName
+constexpr std::uint32_t internedEventNames = 2;
+constexpr std::uint32_t nameIID = 1;
+constexpr std::uint32_t nameName = 2;
+
+/// Returns the uuid of the track of a process, the tracks of its threads follow
+std::uint64_t getProcessUUID(int pid)
+{
+  return (static_cast<std::uint64_t>(pid) + 1) << 32;
+}
+
+/// Bytes of packets collected before writing them
+constexpr std::size_t blockSize = 1 << 16;
+
+}
+
+void writePerfettoProcess(std::ostream & out, int pid, std::string const & name)
+{
+  ProtoWriter process, track, packet, trace;
+  process.varint(perfetto::processPID, pid);
+  process.string(perfetto::processName, name);
+  track.varint(perfetto::trackUUID, perfetto::getProcessUUID(pid));
+  track.message(perfetto::trackProcess, process);
+  packet.message(perfetto::trackDescriptor, track);
+  trace.message(perfetto::packet, packet);
+  out.write(trace.data().data(), trace.data().size());
+}
+
+void writePerfettoPackets(std::ostream & out, RankData const & rank, std::vector<std::string> const & names,
+                          int pid, int rankIndex, std::uint64_t & sequenceCount)
+{
+  using namespace std::chrono;
+
+  /// Incremental state of the sequence of a thread
+  struct Sequence
+  {
+    std::uint64_t id;
+    std::uint64_t track;
+    /// Timestamp of the last packet in nanoseconds
+    std::uint64_t timestamp;
+    /// Whether an event name is interned, indexed by EventID
+    std::vector<bool> interned;
+  };
+  std::map<int, Sequence> sequences;
+
+  // Number of open slices of each thread and event, a stop without one follows a pause, which already ended it
+  std::unordered_map<std::uint64_t, std::size_t> open;
+
+  // Packets are collected in trace, the nested messages reuse their buffers
+  ProtoWriter trace, packet, message, nested, interned;
+  auto const addPacket = [&] {
+    trace.message(perfetto::packet, packet);
+    packet.clear();
+    if (trace.data().size() >= perfetto::blockSize) {
+      out.write(trace.data().data(), trace.data().size());
+      trace.clear();
+    }
+  };
+
+  for (auto const & sc : rank.stateChanges) {
+    auto & slices = open[static_cast<std::uint64_t>(sc.thread) << 32 | static_cast<std::uint32_t>(sc.id)];
+    if (sc.state == Event::State::STARTED)
+      ++slices;
+    else if (slices == 0)
+      continue;
+    else
+      --slices;
+
+    auto it = sequences.find(sc.thread);
+    if (it == sequences.end()) {
+      // Sequences and tracks are numbered in order of appearance by the threads of all ranks, the tid is that of writeTrace
+      long const tid = getTraceTID(rankIndex, sc.thread);
+      ++sequenceCount;
+      Sequence sequence{sequenceCount, perfetto::getProcessUUID(pid) + sequenceCount, 0, {}};
+      it = sequences.emplace(sc.thread, sequence).first;
+
+      // Starts the incremental clock at zero and makes the track of the thread the default
+      packet.varint(perfetto::timestamp, 0);
+      packet.varint(perfetto::timestampClockID, perfetto::boottime);
+      packet.varint(perfetto::sequenceID, sequence.id);
+      packet.varint(perfetto::sequenceFlags, perfetto::incrementalStateCleared);
+      nested.clear();
+      nested.varint(perfetto::defaultTrackUUID, sequence.track);
+      message.clear();
+      message.varint(perfetto::defaultClockID, perfetto::incrementalClock);
+      message.message(perfetto::trackEventDefaults, nested);
+      packet.message(perfetto::packetDefaults, message);
+      message.clear();
+      nested.clear();
+      nested.varint(perfetto::clockID, perfetto::boottime);
+      nested.varint(perfetto::clockTimestamp, 0);
+      message.message(perfetto::clocks, nested);
+      nested.clear();
+      nested.varint(perfetto::clockID, perfetto::incrementalClock);
+      nested.varint(perfetto::clockTimestamp, 0);
+      nested.varint(perfetto::clockIncremental, 1);
+      message.message(perfetto::clocks, nested);
+      packet.message(perfetto::clockSnapshot, message);
+      addPacket();
+
+      nested.clear();
+      nested.varint(perfetto::threadPID, pid);
+      nested.varint(perfetto::threadTID, tid);
+      nested.string(perfetto::threadName, getThreadName(rankIndex, sc.thread));
+      message.clear();
+      message.varint(perfetto::trackUUID, sequence.track);
+      message.varint(perfetto::trackParentUUID, perfetto::getProcessUUID(pid));
+      message.message(perfetto::trackThread, nested);
+      packet.varint(perfetto::timestamp, 0);
+      packet.varint(perfetto::sequenceID, sequence.id);
+      packet.message(perfetto::trackDescriptor, message);
+      addPacket();
+    }
+    auto & sequence = it->second;
+
+    // The difference is unsigned, the timestamps of a thread do not decrease
+    auto const ns = duration_cast<nanoseconds>(sc.timestamp.time_since_epoch()).count();
+    auto const timestamp = std::max<std::uint64_t>(sequence.timestamp, std::max<long long>(ns, 0));
+    packet.varint(perfetto::timestamp, timestamp - sequence.timestamp);
+    sequence.timestamp = timestamp;
+    packet.varint(perfetto::sequenceID, sequence.id);
+    packet.varint(perfetto::sequenceFlags, perfetto::needsIncrementalState);
+
+    // A start begins a slice, named by the index of the interned name, which is added on first use
+    message.clear();
+    if (sc.state == Event::State::STARTED) {
+      auto const id = static_cast<std::size_t>(sc.id);
+      message.varint(perfetto::eventType, perfetto::sliceBegin);
+      message.varint(perfetto::eventNameIID, id + 1);
+      if (sequence.interned.size() <= id)
+        sequence.interned.resize(id + 1);
+      if (not sequence.interned[id]) {
+        sequence.interned[id] = true;
+        nested.clear();
+        nested.varint(perfetto::nameIID, id + 1);
+        nested.string(perfetto::nameName, names[sc.id]);
+        interned.clear();
+        interned.message(perfetto::internedEventNames, nested);
+        packet.message(perfetto::internedData, interned);
+      }
+    }
+    else
+      message.varint(perfetto::eventType, perfetto::sliceEnd);
+    packet.message(perfetto::trackEvent, message);
+    addPacket();
+  }
+  out.write(trace.data().data(), trace.data().size());
+}
+
+
+/// 64 bit FNV-1a hash of a name
+std::uint64_t hashName(std::string const & name)
+{
+  std::uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : name) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+
+std::uint32_t NameTable::indexOf(std::string const & name) const
+{
+  return std::lower_bound(hashes.begin(), hashes.end(), hashName(name)) - hashes.begin();
+}
+
+
+/// Agrees on a common index of the names of all ranks, without gathering the names of each rank at one rank.
+/**
+ * The names are merged along a binomial tree towards rank 0, each rank sends the union of the names of its
+ * subtree once. Rank 0 broadcasts the sorted hashes of all names, which are the index.
+ * Two different names of equal hash would be merged, hence all ranks throw std::runtime_error then.
+ */
+class NameAgreement : public Collective
+{
+public:
+  /// @param[in] names Names on this rank
+  NameAgreement(std::vector<std::string> const & names, MPI_Comm comm)
+    : comm(comm)
+  {
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    for (auto const & name : names)
+      add(hashName(name), name);
+  }
+
+  NameTable table;
+
+private:
+  static constexpr int tag = 1;
+
+  MPI_Comm comm;
+  int rank, size;
+
+  enum class Stage { MERGE, RECEIVED, BROADCAST, RESULT } stage = Stage::MERGE;
+
+  /// Union of the names of the subtree by hash and the first collision found in it, if any
+  std::map<std::uint64_t, std::string> subtree;
+  std::string collision;
+
+  /// The child rank + mask is received next
+  int mask = 1;
+
+  std::vector<char> recvBuf;
+  PackBuffer sendBuf, result;
+  std::uint64_t resultSize = 0;
+
+  void add(std::uint64_t hash, std::string const & name)
+  {
+    auto insertion = subtree.emplace(hash, name);
+    if (not insertion.second and insertion.first->second != name and collision.empty())
+      collision = "'" + insertion.first->second + "' and '" + name + "'";
+  }
+
+  Step step(bool block) override
+  {
+    switch (stage) {
+    case Stage::RECEIVED: {
+      UnpackBuffer buffer(recvBuf.data(), recvBuf.data() + recvBuf.size());
+      auto const childCollision = buffer.get<std::string>();
+      if (collision.empty())
+        collision = childCollision;
+      auto const n = buffer.get<std::size_t>();
+      for (std::size_t i = 0; i < n; ++i) {
+        auto const hash = buffer.get<std::uint64_t>();
+        add(hash, buffer.get<std::string>());
+      }
+      mask <<= 1;
+      stage = Stage::MERGE;
+    }
+    // fall through
+    case Stage::MERGE:
+      // Receives the subtrees of rank + 1, rank + 2, rank + 4, ... up to the lowest set bit of rank,
+      // then sends the union to the parent rank without that bit
+      for (; mask < size; mask <<= 1) {
+        if (rank & mask) {
+          sendBuf.pack(collision);
+          sendBuf.pack(subtree.size());
+          for (auto const & n : subtree) {
+            sendBuf.pack(n.first);
+            sendBuf.pack(n.second);
+          }
+          requests.emplace_back();
+          MPI_Isend(sendBuf.data.data(), sendBuf.data.size(), MPI_BYTE, rank - mask, tag, comm, &requests.back());
+          break;
+        }
+        if (rank + mask >= size)
+          continue;
+
+        // The size of the subtree is known once its message arrived
+        MPI_Message message;
+        MPI_Status status;
+        if (block)
+          MPI_Mprobe(rank + mask, tag, comm, &message, &status);
+        else {
+          int arrived;
+          MPI_Improbe(rank + mask, tag, comm, &arrived, &message, &status);
+          if (not arrived)
+            return Step::PENDING;
+        }
+        int count;
+        MPI_Get_count(&status, MPI_BYTE, &count);
+        recvBuf.resize(count);
+        requests.emplace_back();
+        MPI_Imrecv(recvBuf.data(), count, MPI_BYTE, &message, &requests.back());
+        stage = Stage::RECEIVED;
+        return Step::NEXT;
+      }
+
+      // Only the hashes are broadcast, the names are needed at rank 0 only
+      if (rank == 0) {
+        for (auto const & n : subtree) {
+          table.hashes.push_back(n.first);
+          table.names.push_back(n.second);
+        }
+        result.pack(collision);
+        result.pack(table.hashes);
+      }
+      resultSize = result.data.size();
+      requests.emplace_back();
+      MPI_Ibcast(&resultSize, 1, MPI_UINT64_T, 0, comm, &requests.back());
+      stage = Stage::BROADCAST;
+      return Step::NEXT;
+
+    case Stage::BROADCAST:
+      result.data.resize(resultSize);
+      requests.emplace_back();
+      MPI_Ibcast(result.data.data(), resultSize, MPI_BYTE, 0, comm, &requests.back());
+      stage = Stage::RESULT;
+      return Step::NEXT;
+
+    case Stage::RESULT: {
+      UnpackBuffer buffer(result.data.data(), result.data.data() + result.data.size());
+      buffer.unpack(collision);
+      if (not collision.empty())
+        throw std::runtime_error("The names " + collision + " have the same hash, rename one of them");
+      if (rank != 0)
+        buffer.unpack(table.hashes);
+      return Step::LAST;
+    }
+    }
+    return Step::LAST;
+  }
+};
+
+constexpr int NameAgreement::tag;
+
+/// Agrees on a common index of the names of all ranks, see NameAgreement
+/** @param[in] names Names on this rank */
+NameTable agreeOnNames(std::vector<std::string> const & names, MPI_Comm comm)
+{
+  NameAgreement agreement(names, comm);
+  agreement.progress(true);
+  return std::move(agreement.table);
+}
+
+
+/// Statistics of one event in a fixed layout, reduced over all ranks by reduceEventStats
+struct ReducedEventStats
+{
+  long count = 0;
+  long total = 0;
+  long max = std::numeric_limits<long>::min();
+  long min = std::numeric_limits<long>::max();
+  int maxRank = -1;
+  int minRank = -1;
+  double sumSquares = 0;
+  std::uint64_t buckets[Histogram::buckets] = {};
+};
+
+/// MPI_User_function that combines ReducedEventStats, ties of min and max go to the lower rank
+void reduceEventStats(void * in, void * inout, int * len, MPI_Datatype *)
+{
+  auto a = static_cast<ReducedEventStats const *>(in);
+  auto b = static_cast<ReducedEventStats *>(inout);
+  for (int i = 0; i < *len; ++i, ++a, ++b) {
+    if (a->count == 0)
+      continue;
+    if (b->count == 0 or a->max > b->max or (a->max == b->max and a->maxRank < b->maxRank)) {
+      b->max = a->max;
+      b->maxRank = a->maxRank;
+    }
+    if (b->count == 0 or a->min < b->min or (a->min == b->min and a->minRank < b->minRank)) {
+      b->min = a->min;
+      b->minRank = a->minRank;
+    }
+    b->count += a->count;
+    b->total += a->total;
+    b->sumSquares += a->sumSquares;
+    for (int j = 0; j < Histogram::buckets; ++j)
+      b->buckets[j] += a->buckets[j];
+  }
+}
+
+/// MPI_User_function that merges DataSummary
+void reduceDataSummaries(void * in, void * inout, int * len, MPI_Datatype *)
+{
+  auto a = static_cast<DataSummary const *>(in);
+  auto b = static_cast<DataSummary *>(inout);
+  for (int i = 0; i < *len; ++i)
+    b[i].merge(a[i]);
+}
+
+/// Reduces a vector of trivially copyable T at rank 0 by the MPI_User_function f
+template<typename T>
+class VectorReduction : public Collective
+{
+public:
+  VectorReduction(std::vector<T> values, MPI_User_function * f, MPI_Comm comm)
+    : values(std::move(values)), f(f), comm(comm)
+  {}
+
+  /// The reduced values, only at rank 0
+  std::vector<T> result;
+
+private:
+  std::vector<T> values;
+  MPI_User_function * f;
+  MPI_Comm comm;
+
+  MPI_Datatype type = MPI_DATATYPE_NULL;
+  MPI_Op op = MPI_OP_NULL;
+
+  Step step(bool) override
+  {
+    // The type and operation are freed once the reduction completed
+    if (op != MPI_OP_NULL) {
+      MPI_Op_free(&op);
+      MPI_Type_free(&type);
+      return Step::LAST;
+    }
+
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Type_contiguous(sizeof(T), MPI_BYTE, &type);
+    MPI_Type_commit(&type);
+    MPI_Op_create(f, 1, &op);
+
+    result.resize(rank == 0 ? values.size() : 0);
+    requests.emplace_back();
+    MPI_Ireduce(values.data(), result.data(), values.size(), type, op, 0, comm, &requests.back());
+    return Step::NEXT;
+  }
+};
+
+
+void pack(PackBuffer & buffer, DataStore const & data)
+{
+  buffer.pack(data.size());
+  for (auto const & c : data.getColumns()) {
+    auto const & column = c.second;
+    buffer.pack(c.first);
+    buffer.pack(column.values.type);
+    buffer.pack(column.values.integers);
+    buffer.pack(column.values.reals);
+    buffer.pack(column.instances);
+    buffer.pack(column.summaryOnly);
+    buffer.pack(column.summary);
+  }
+}
+
+DataStore unpackDataStore(UnpackBuffer & buffer)
+{
+  DataStore data;
+  auto const size = buffer.get<std::size_t>();
+  for (std::size_t i = 0; i < size; ++i) {
+    auto const key = buffer.get<std::string>();
+    DataStore::Column column;
+    buffer.unpack(column.values.type);
+    buffer.unpack(column.values.integers);
+    buffer.unpack(column.values.reals);
+    buffer.unpack(column.instances);
+    buffer.unpack(column.summaryOnly);
+    buffer.unpack(column.summary);
+    data.append(key, column);
+  }
+  return data;
+}
+
+void pack(PackBuffer & buffer, std::uint32_t id, EventData const & ev)
+{
+  buffer.pack(id);
+  buffer.pack(ev.getCount());
+  buffer.pack(ev.getTotal());
+  buffer.pack(ev.getMax());
+  buffer.pack(ev.getMin());
+  buffer.pack(ev.sumSquares);
+
+  // The non-empty buckets of the histogram as pairs of index and count
+  std::vector<long> buckets;
+  for (auto const & bucket : ev.getHistogram().getBuckets()) {
+    buckets.push_back(bucket.first);
+    buckets.push_back(bucket.second);
+  }
+  buffer.pack(buckets);
+  pack(buffer, ev.getData());
+}
+
+std::pair<std::uint32_t, EventData> unpackEventData(UnpackBuffer & buffer, std::vector<std::string> const & names)
+{
+  auto const id = buffer.get<std::uint32_t>();
+  if (not names.empty() and id >= names.size())
+    throw std::out_of_range("Invalid index of an event");
+  auto const count = buffer.get<long>();
+  auto const total = buffer.get<long>();
+  auto const max = buffer.get<long>();
+  auto const min = buffer.get<long>();
+  auto const sumSquares = buffer.get<double>();
+
+  Histogram histogram;
+  auto const buckets = buffer.get<std::vector<long>>();
+  for (size_t j = 0; j + 1 < buckets.size(); j += 2) {
+    if (buckets[j] < 0 or buckets[j] >= Histogram::buckets)
+      throw std::out_of_range("Invalid bucket of a histogram");
+    histogram.add(static_cast<int>(buckets[j]), buckets[j+1]);
+  }
+
+  auto data = unpackDataStore(buffer);
+  return {id, EventData(names.empty() ? "" : names[id], count, total, max, min, sumSquares,
+                        std::move(data), std::move(histogram))};
+}
+
+void pack(PackBuffer & buffer, Event::StateChange const & sc)
+{
+  buffer.pack(static_cast<std::int64_t>(sc.timestamp.time_since_epoch().count()));
+  buffer.pack(static_cast<std::int32_t>(sc.id));
+  buffer.pack(static_cast<std::int32_t>(sc.thread));
+  buffer.pack(static_cast<std::int32_t>(sc.state));
+}
+
+Event::StateChange unpackStateChange(UnpackBuffer & buffer)
+{
+  Event::StateChange sc;
+  sc.timestamp = Event::Clock::time_point(Event::Clock::duration(buffer.get<std::int64_t>()));
+  sc.id = buffer.get<std::int32_t>();
+  sc.thread = buffer.get<std::int32_t>();
+  sc.state = static_cast<Event::State>(buffer.get<std::int32_t>());
+  return sc;
+}
+
+RankData unpackRankData(UnpackBuffer & buffer, std::vector<std::string> const & names,
+                        std::vector<EventID> const & localIDs, std::vector<std::string> const & localNames)
+{
+  RankData data;
+  data.initializedAt = sys_clk::time_point(sys_clk::duration(buffer.get<sys_clk::rep>()));
+  data.finalizedAt = sys_clk::time_point(sys_clk::duration(buffer.get<sys_clk::rep>()));
+
+  auto const events = buffer.get<std::ptrdiff_t>();
+  for (std::ptrdiff_t j = 0; j < events; ++j) {
+    auto ev = unpackEventData(buffer, names);
+    data.addEventData(localIDs.at(ev.first), std::move(ev.second), localNames);
+  }
+
+  auto const stateChanges = buffer.get<std::size_t>();
+  for (std::size_t i = 0; i < stateChanges; ++i) {
+    auto sc = unpackStateChange(buffer);
+    sc.id = localIDs.at(sc.id);
+    data.stateChanges.push(sc);
+  }
+  return data;
+}
+
+/// Gathers the buffers of all ranks of comm at rank 0 of comm
+class BufferGather : public Collective
+{
+public:
+  BufferGather(std::vector<char> sendBuf, MPI_Comm comm)
+    : sendBuf(std::move(sendBuf)), comm(comm)
+  {}
+
+  /// Readers of the buffers of all ranks, only at rank 0
+  std::vector<UnpackBuffer> buffers;
+
+private:
+  std::vector<char> sendBuf, recvBuf;
+  MPI_Comm comm;
+
+  enum class Stage { SIZES, BUFFERS, READERS } stage = Stage::SIZES;
+
+  int sendSize = 0;
+  std::vector<int> recvSizes, displacements;
+
+  Step step(bool) override
+  {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    switch (stage) {
+    case Stage::SIZES:
+      // Displacements are int, hence at most 2 GiB can be gathered
+      sendSize = sendBuf.size();
+      recvSizes.resize(size);
+      displacements.resize(size);
+      requests.emplace_back();
+      MPI_Igather(&sendSize, 1, MPI_INT, recvSizes.data(), 1, MPI_INT, 0, comm, &requests.back());
+      stage = Stage::BUFFERS;
+      return Step::NEXT;
+
+    case Stage::BUFFERS:
+      if (rank == 0) {
+        std::partial_sum(recvSizes.begin(), recvSizes.end() - 1, displacements.begin() + 1);
+        recvBuf.resize(displacements.back() + recvSizes.back());
+      }
+      requests.emplace_back();
+      MPI_Igatherv(sendBuf.data(), sendSize, MPI_BYTE,
+                   recvBuf.data(), recvSizes.data(), displacements.data(), MPI_BYTE, 0, comm, &requests.back());
+      stage = Stage::READERS;
+      return Step::NEXT;
+
+    case Stage::READERS:
+      if (rank == 0)
+        for (int i = 0; i < size; ++i)
+          buffers.emplace_back(recvBuf.data() + displacements[i], recvBuf.data() + displacements[i] + recvSizes[i]);
+      return Step::LAST;
+    }
+    return Step::LAST;
+  }
+};
+
+/// Merges buffers packed by EventRegistry::collect into a single one, without state changes
+PackBuffer mergeBuffers(std::vector<UnpackBuffer> buffers)
+{
+  auto initializedAt = std::numeric_limits<sys_clk::rep>::max();
+  auto finalizedAt = std::numeric_limits<sys_clk::rep>::min();
+  std::map<std::uint32_t, EventData> events;
+  for (auto & buffer : buffers) {
+    initializedAt = std::min(initializedAt, buffer.get<sys_clk::rep>());
+    finalizedAt = std::max(finalizedAt, buffer.get<sys_clk::rep>());
+    auto const n = buffer.get<std::ptrdiff_t>();
+    for (std::ptrdiff_t j = 0; j < n; ++j) {
+      auto ev = unpackEventData(buffer, {});
+      auto insertion = events.emplace(ev.first, EventData(""));
+      insertion.first->second.merge(ev.second);
+    }
+  }
+
+  PackBuffer merged;
+  merged.pack(initializedAt);
+  merged.pack(finalizedAt);
+  merged.pack(static_cast<std::ptrdiff_t>(events.size()));
+  for (auto const & ev : events)
+    pack(merged, ev.first, ev.second);
+  merged.pack(std::size_t(0)); // No state changes
+  return merged;
+}
+
+
+// -----------------------------------------------------------------------
+
+void DataSummary::add(double value)
+{
+  ++count;
+  min = std::min(min, value);
+  max = std::max(max, value);
+  double const delta = value - mean;
+  mean += delta / count;
+  m2 += delta * (value - mean);
+}
+
+void DataSummary::merge(DataSummary const & other)
+{
+  if (other.count == 0)
+    return;
+
+  long const n = count + other.count;
+  double const delta = other.mean - mean;
+  mean += delta * other.count / n;
+  m2 += other.m2 + delta * delta * count * other.count / n;
+  count = n;
+  min = std::min(min, other.min);
+  max = std::max(max, other.max);
+}
+
+double DataSummary::getSum() const
+{
+  return mean * count;
+}
+
+double DataSummary::getVariance() const
+{
+  return divOrZero(m2, count);
+}
+
+
+// -----------------------------------------------------------------------
+
+void DataStore::put(long instance, Event::Data const & data)
+{
+  for (auto const & d : data) {
+    auto insertion = columns.emplace(d.first, Column());
+    auto & column = insertion.first->second;
+    if (insertion.second)
+      column.summaryOnly = EventRegistry::instance().isSummaryOnly(d.first);
+
+    auto const & values = d.second;
+    if (column.summaryOnly) {
+      for (std::size_t i = 0; i < values.size(); ++i)
+        column.summary.add(values.get(i));
+    }
+    else {
+      column.values.append(values);
+      column.instances.insert(column.instances.end(), values.size(), instance);
+    }
+  }
+}
+
+void DataStore::append(std::string const & key, Column const & column, long instanceOffset)
+{
+  auto insertion = columns.emplace(key, Column());
+  auto & target = insertion.first->second;
+  if (insertion.second)
+    target.summaryOnly = column.summaryOnly;
+
+  target.summary.merge(column.summary);
+  target.values.append(column.values);
+  target.instances.reserve(target.instances.size() + column.instances.size());
+  for (auto instance : column.instances)
+    target.instances.push_back(instance + instanceOffset);
+}
+
+void DataStore::merge(DataStore const & other, long instanceOffset)
+{
+  for (auto const & c : other.columns)
+    append(c.first, c.second, instanceOffset);
+}
+
+std::map<std::string, DataStore::Column> const & DataStore::getColumns() const
+{
+  return columns;
+}
+
+std::size_t DataStore::size() const
+{
+  return columns.size();
+}
+
+void DataStore::clear()
+{
+  columns.clear();
+}
+
+
+// -----------------------------------------------------------------------
+
+EventData::EventData(std::string _name) :
+  name(_name)
+{}
+
+EventData::EventData(std::string _name, long _count, long _total, long _max, long _min, double _sumSquares,
+                     DataStore data, Histogram histogram)
+  :  max(Event::Clock::duration(_max)),
+     min(Event::Clock::duration(_min)),
+     total(Event::Clock::duration(_total)),
+     sumSquares(_sumSquares),
+     name(_name),
+     count(_count),
+     data(std::move(data)),
+     histogram(std::move(histogram))
+{}
+
+
+void EventData::merge(EventData const & other)
+{
+  data.merge(other.data, count);
+  count += other.count;
+  total += other.total;
+  sumSquares += other.sumSquares;
+  min = std::min(other.min, min);
+  max = std::max(other.max, max);
+  histogram.merge(other.histogram);
+}
+
+
+void EventData::put(Event const & event)
+{
+#ifndef EVENTTIMINGS_DISABLED // Disabled events are never put
+  data.put(count, event.data);
+  count++;
+  Event::Clock::duration duration = event.getDuration();
+  total += duration;
+  sumSquares += static_cast<double>(duration.count()) * duration.count();
+  min = std::min(duration, min);
+  max = std::max(duration, max);
+  histogram.add(duration.count());
+#else
+  (void)event;
+#endif
+}
+
+std::string const & EventData::getName() const
+{
+  return name;
+}
+
+long EventData::getAvg() const
+{
+  return (total / count).count();
+}
+
+double EventData::getStdDev() const
+{
+  double const mean = divOrZero(total.count(), count);
+  return std::sqrt(std::max(0.0, divOrZero(sumSquares, count) - mean * mean));
+}
+
+long EventData::getMax() const
+{
+  return max.count();
+}
+
+long EventData::getMin() const
+{
+  return min.count();
+}
+
+long EventData::getTotal() const
+{
+  return total.count();
+}
+
+long EventData::getCount() const
+{
+  return count;
+}
+
+long EventData::getPercentile(double percentage) const
+{
+  if (count == 0)
+    return 0;
+  // The histogram returns the midpoint of a bucket, which may lie outside of the actual range
+  return std::min(std::max(histogram.getPercentile(percentage), min.count()), max.count());
+}
+
+DataStore const & EventData::getData() const
+{
+  return data;
+}
+
+Histogram const & EventData::getHistogram() const
+{
+  return histogram;
+}
+
+
+
+// -----------------------------------------------------------------------
+
+long GlobalEventStats::getAvg() const
+{
+  return count > 0 ? total / count : 0;
+}
+
+double GlobalEventStats::getStdDev() const
+{
+  double const mean = divOrZero(total, count);
+  return std::sqrt(std::max(0.0, divOrZero(sumSquares, count) - mean * mean));
+}
+
+long GlobalEventStats::getPercentile(double percentage) const
+{
+  if (histogram.getCount() == 0)
+    return 0;
+  return std::min(std::max(histogram.getPercentile(percentage), min.count()), max.count());
+}
+
+
+// -----------------------------------------------------------------------
+
+constexpr std::size_t Timeline::chunkSize;
+
+void Timeline::append(Timeline && other)
+{
+  std::move(other.chunks.begin(), other.chunks.end(), std::back_inserter(chunks));
+  other.chunks.clear();
+}
+
+void Timeline::clear()
+{
+  for (auto & chunk : chunks) {
+    chunk->size = 0;
+    freeChunks.push_back(std::move(chunk));
+  }
+  chunks.clear();
+}
+
+std::size_t Timeline::release()
+{
+  std::size_t const n = chunks.size() + freeChunks.size();
+  chunks.clear();
+  freeChunks.clear();
+  return n;
+}
+
+std::size_t Timeline::size() const
+{
+  std::size_t size = 0;
+  for (auto const & chunk : chunks)
+    size += chunk->size;
+  return size;
+}
+
+void Timeline::setSpill(TraceSpill * spill)
+{
+  this->spill = spill;
+}
+
+void Timeline::addChunk()
+{
+  if (not freeChunks.empty()) {
+    chunks.push_back(std::move(freeChunks.back()));
+    freeChunks.pop_back();
+  }
+  else if (spill) {
+    auto chunk = spill->exchange(chunks);
+    chunks.push_back(std::move(chunk));
+  }
+  else {
+    chunks.emplace_back(new Chunk);
+  }
+}
+
+
+// -----------------------------------------------------------------------
+
+void RankData::initialize()
+{
+  initializedAt = sys_clk::now();
+  initializedAtTicks = Event::Clock::now();
+  isFinalized = false;
+}
+
+void RankData::finalize()
+{
+  finalizedAt = sys_clk::now();
+  finalizedAtTicks = Event::Clock::now();
+  isFinalized = true;
+}
+
+
+void RankData::put(Event const & event)
+{
+#ifndef EVENTTIMINGS_DISABLED // Disabled events are never put
+  getEventData(event.id).put(event);
+#else
+  (void)event;
+#endif
+}
+
+
+void RankData::addEventData(EventData ed)
+{
+  EventID const id = EventRegistry::instance().registerEvent(ed.getName());
+  getEventData(id) = std::move(ed);
+}
+
+
+void RankData::addEventData(EventID id, EventData ed, std::vector<std::string> const & names)
+{
+  for (EventID i = evData.size(); i <= id; ++i)
+    evData.emplace_back(names.at(i));
+
+  evData[id] = std::move(ed);
+}
+
+
+EventData & RankData::getEventData(EventID id)
+{
+  // Creates EventData objects for all events registered up to this one
+  for (EventID i = evData.size(); i <= id; ++i)
+    evData.emplace_back(EventRegistry::instance().getEventName(i));
+
+  return evData[id];
+}
+
+
+void RankData::merge(RankData && other)
+{
+  for (EventID id = evData.size(); id < static_cast<EventID>(other.evData.size()); ++id)
+    evData.emplace_back(other.evData[id].getName());
+
+  for (size_t id = 0; id < other.evData.size(); ++id)
+    if (other.evData[id].getCount() > 0)
+      evData[id].merge(other.evData[id]);
+
+  stateChanges.append(std::move(other.stateChanges));
+}
+
+
+std::vector<EventData const *> RankData::getEvents() const
+{
+  std::vector<EventData const *> events;
+  for (auto const & ed : evData)
+    if (ed.getCount() > 0)
+      events.push_back(&ed);
+
+  std::sort(events.begin(), events.end(), [](EventData const * a, EventData const * b) {
+      return a->getName() < b->getName();
+    });
+  return events;
+}
+
+
+void RankData::normalizeTo(Event::Clock::time_point t0, ClockOffset const & first, ClockOffset const & last)
+{
+  assert(t0 <= getInitializedAt(first)); // t0 should always be before or equal my init time
+
+  normalizationBase = first.at;
+  normalization = first.offset - t0.time_since_epoch();
+  // Real clocks drift by less than 1e-3, larger values are errors of the estimates over a short time
+  drift = last.at > first.at ? static_cast<double>((last.offset - first.offset).count()) / (last.at - first.at).count() : 0;
+  drift = std::max(-maxDrift, std::min(drift, maxDrift));
+  for (auto & sc : stateChanges) {
+    auto & tp = sc.timestamp;
+    tp = normalize(tp);
+    assert(tp.time_since_epoch().count() >= 0); // Trying to do normalize twice?
+  }
+}
+
+Event::Clock::time_point RankData::getInitializedAt(ClockOffset const & offset) const
+{
+  return initializedAtTicks + offset.offset;
+}
+
+Event::Clock::time_point RankData::normalize(Event::Clock::time_point timestamp) const
+{
+  auto const correction = static_cast<Event::Clock::rep>(drift * (timestamp - normalizationBase).count());
+  return timestamp + normalization + Event::Clock::duration(correction);
+}
+
+void RankData::clear()
+{
+  evData.clear();
+  stateChanges.clear();
+}
+
+sys_clk::duration RankData::getDuration() const
+{
+  if (isFinalized)
+    return finalizedAt - initializedAt;
+  else
+    return sys_clk::now() - initializedAt;
+}
+
+
 
+// -----------------------------------------------------------------------
 
-struct MPI_EventData
+/// Recording storage of a single thread, merged into the RankData of this rank at finalize.
+/** The padding keeps the shards of different threads on separate cache lines. */
+struct EventRegistry::ThreadShard
 {
-  char name[255] = {'\0'};
-  int count = 0;
-  long total = 0, max = 0, min = 0;
-  int dataSize = 0, stateChangesSize = 0;
+  explicit ThreadShard(int thread) : thread(thread) {}
+
+  char paddingFront[64];
+  RankData data;
+  int const thread;
+
+  /// Copy of the EventIDs of the names registered by this thread, names are never unregistered
+  std::unordered_map<std::string, EventID> eventIDs;
+  char paddingBack[64];
 };
 
+thread_local EventRegistry::ThreadShard * EventRegistry::localShard = nullptr;
 
-// -----------------------------------------------------------------------
+thread_local std::string EventRegistry::prefix;
 
-EventData::EventData(std::string _name) :
-  name(_name)
-{}
 
-EventData::EventData(std::string _name, long _count, long _total, long _max, long _min,
-                     Event::Data data, Event::StateChanges _stateChanges)
-  :  max(std::chrono::milliseconds(_max)),
-     min(std::chrono::milliseconds(_min)),
-     total(std::chrono::milliseconds(_total)),
-     stateChanges(_stateChanges),
-     name(_name),
-     count(_count),
-     data(data)
+EventRegistry::EventRegistry()
+  : eventIDs{{"_GLOBAL", 0}},
+    eventNames{"_GLOBAL"},
+    eventLevels{0},
+    eventRecordings{-1},
+    globalEvent(0, true, false), // Unstarted, it's started in initialize
+    clockSource(Clock::Source::EVENTTIMINGS_CLOCK)
 {}
 
+EventRegistry::~EventRegistry() = default;
 
-void EventData::put(Event const & event)
+EventRegistry & EventRegistry::instance()
 {
-  count++;
-  stdy_clk::duration duration = event.getDuration();
-  total += duration;
-  min = std::min(duration, min);
-  max = std::max(duration, max);
-  for (auto const & d : event.data) {
-    auto & source = std::get<1>(d);
-    auto & target = data[std::get<0>(d)];
-    target.insert(target.begin(), source.begin(), source.end());
+  static EventRegistry instance;
+  return instance;
+}
+
+void EventRegistry::initialize(std::string applicationName, std::string runName, MPI_Comm comm)
+{
+  this->applicationName = applicationName;
+  this->runName = runName;
+  this->comm = comm;
+
+  Clock::setSource(clockSource);
+  localRankData.initialize();
+  initialOffset = estimateClockOffset(comm);
+
+  if (traceBudget > 0) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    std::lock_guard<std::mutex> lock(shardsMutex);
+    traceSpill.reset(new TraceSpill(applicationName + "-events." + std::to_string(rank) + ".spill", traceBudget));
+    for (auto & shard : shards)
+      shard->data.stateChanges.setSpill(traceSpill.get());
   }
-  stateChanges.insert(std::end(stateChanges), std::begin(event.stateChanges), std::end(event.stateChanges));
+
+  sharedFileSize = 0;
+  lastCheckpoint = std::chrono::steady_clock::now();
+  checkpointDecision = 0;
+
+  globalEvent.start(false);
+  initialized = true;
 }
 
-std::string EventData::getName() const
+void EventRegistry::setClockSource(Clock::Source source)
 {
-  return name;
+  clockSource = source;
 }
 
-long EventData::getAvg() const
+void EventRegistry::setSummaryOnly(std::string const & key)
 {
-  return (std::chrono::duration_cast<std::chrono::milliseconds>(total) / count).count();
+  std::lock_guard<std::mutex> lock(namesMutex);
+  summaryKeys.insert(key);
 }
 
-long EventData::getMax() const
+bool EventRegistry::isSummaryOnly(std::string const & key) const
 {
-  return std::chrono::duration_cast<std::chrono::milliseconds>(max).count();
+  std::lock_guard<std::mutex> lock(namesMutex);
+  return summaryKeys.count(key) > 0;
 }
 
-long EventData::getMin() const
+void EventRegistry::setGather(Gather gather)
 {
-  return std::chrono::duration_cast<std::chrono::milliseconds>(min).count();
+  this->gather = gather;
 }
 
-long EventData::getTotal() const
+void EventRegistry::setTraceFormat(TraceFormat format)
 {
-  return std::chrono::duration_cast<std::chrono::milliseconds>(total).count();
+  traceFormat = format;
 }
 
-long EventData::getCount() const
+void EventRegistry::setTraceBudget(std::size_t bytes)
 {
-  return count;
+  traceBudget = bytes;
 }
 
-Event::Data const & EventData::getData() const
+/// Unpacks the buffers gathered from all ranks at rank 0, the names of the table are registered
+std::vector<RankData> unpackRanks(EventRegistry & registry, std::vector<UnpackBuffer> & buffers,
+                                  NameTable const & names)
 {
-  return data;
+  // Maps the indices of the name table to the local EventIDs
+  std::vector<EventID> localIDs;
+  for (auto const & name : names.names)
+    localIDs.push_back(registry.registerEvent(name));
+  auto const localNames = registry.getEventNames();
+
+  std::vector<RankData> ranks;
+  for (auto & buffer : buffers)
+    ranks.push_back(unpackRankData(buffer, names.names, localIDs, localNames));
+  return ranks;
 }
 
 
+class EventRegistry::Normalization : public Collective
+{
+public:
+  explicit Normalization(EventRegistry & registry)
+    : registry(registry), clock(registry.comm)
+  {}
+
+private:
+  EventRegistry & registry;
+  ClockEstimation clock;
+  bool reducing = false;
+  long ticks = 0, minTicks = 0;
+
+  Step step(bool block) override
+  {
+    if (not reducing) {
+      if (not clock.progress(block))
+        return Step::PENDING;
+
+      // Zero is the first initialize of all ranks on the clock of rank 0
+      ticks = registry.localRankData.getInitializedAt(registry.initialOffset).time_since_epoch().count();
+      requests.emplace_back();
+      MPI_Iallreduce(&ticks, &minTicks, 1, MPI_LONG, MPI_MIN, registry.comm, &requests.back());
+      reducing = true;
+      return Step::NEXT;
+    }
 
-// -----------------------------------------------------------------------
+    Event::Clock::time_point t0{Event::Clock::duration{minTicks}};
+    registry.localRankData.normalizeTo(t0, registry.initialOffset, clock.estimate);
+    return Step::LAST;
+  }
+};
 
-void RankData::initialize()
-{
-  initializedAt = sys_clk::now();
-  initializedAtTicks = stdy_clk::now();
-  isFinalized = false;
-}
 
-void RankData::finalize()
+class EventRegistry::Reduction : public Collective
 {
-  finalizedAt = sys_clk::now();
-  finalizedAtTicks = stdy_clk::now();
-  isFinalized = true;
-}
+public:
+  Reduction(EventRegistry & registry, NameTable const & names)
+    : registry(registry), names(names)
+  {
+    MPI_Comm_rank(registry.comm, &rank);
+  }
 
+private:
+  EventRegistry & registry;
+  NameTable const & names;
+  int rank;
 
-void RankData::put(Event const & event)
-{
-  /// Constructs or returns EventData object with name as key and name as arg to ctor.
-  auto data = std::get<0>(evData.emplace(std::piecewise_construct,
-                                         std::forward_as_tuple(event.name),
-                                         std::forward_as_tuple(event.name)));
-  data->second.put(event);
-}
+  enum class Stage { START, STATS, KEYS, SUMMARIES } stage = Stage::START;
+
+  std::vector<EventData const *> events;
+  std::unique_ptr<VectorReduction<ReducedEventStats>> stats;
+  std::vector<std::string> keys;
+  std::vector<DataSummary const *> localSummaries;
+  std::unique_ptr<NameAgreement> keyTable;
+  std::unique_ptr<VectorReduction<DataSummary>> summaries;
+
+  Step step(bool block) override
+  {
+    switch (stage) {
+    case Stage::START: {
+      // Reduce the statistics of all events in the table, those not recorded on any rank keep a count of 0
+      events = registry.localRankData.getEvents();
+      std::vector<ReducedEventStats> local(names.hashes.size());
+      for (auto const * e : events) {
+        auto & s = local[names.indexOf(e->getName())];
+        s.count = e->getCount();
+        s.total = e->getTotal();
+        s.max = e->getMax();
+        s.maxRank = rank;
+        s.min = e->getMin();
+        s.minRank = rank;
+        s.sumSquares = e->sumSquares;
+        for (auto const & bucket : e->getHistogram().getBuckets())
+          s.buckets[bucket.first] = bucket.second;
+      }
+      stats.reset(new VectorReduction<ReducedEventStats>(std::move(local), &reduceEventStats, registry.comm));
+      stage = Stage::STATS;
+    }
+    // fall through
+    case Stage::STATS:
+      if (not stats->progress(block))
+        return Step::PENDING;
+
+      // Reduce the summaries of summary-only data, named by the event name and the key, separated by '\0'
+      for (auto const * e : events)
+        for (auto const & c : e->getData().getColumns())
+          if (c.second.summaryOnly) {
+            keys.push_back(e->getName() + '\0' + c.first);
+            localSummaries.push_back(&c.second.summary);
+          }
+      keyTable.reset(new NameAgreement(keys, registry.comm));
+      stage = Stage::KEYS;
+      // fall through
+    case Stage::KEYS: {
+      if (not keyTable->progress(block))
+        return Step::PENDING;
+
+      std::vector<DataSummary> local(keyTable->table.hashes.size());
+      for (size_t i = 0; i < keys.size(); ++i)
+        local[keyTable->table.indexOf(keys[i])] = *localSummaries[i];
+      summaries.reset(new VectorReduction<DataSummary>(std::move(local), &reduceDataSummaries, registry.comm));
+      stage = Stage::SUMMARIES;
+    }
+    // fall through
+    case Stage::SUMMARIES:
+      if (not summaries->progress(block))
+        return Step::PENDING;
+      if (rank == 0)
+        store();
+      return Step::LAST;
+    }
+    return Step::LAST;
+  }
 
+  /// Stores the reduced statistics and summaries in globalStats at rank 0
+  void store()
+  {
+    for (size_t i = 0; i < stats->result.size(); ++i) {
+      auto const & s = stats->result[i];
+      if (s.count == 0)
+        continue;
+      auto & global = registry.globalStats[names.names[i]];
+      global.count = s.count;
+      global.total = s.total;
+      global.sumSquares = s.sumSquares;
+      global.max = Event::Clock::duration(s.max);
+      global.maxRank = s.maxRank;
+      global.min = Event::Clock::duration(s.min);
+      global.minRank = s.minRank;
+      for (int j = 0; j < Histogram::buckets; ++j)
+        if (s.buckets[j] > 0)
+          global.histogram.add(j, s.buckets[j]);
+    }
 
-void RankData::addEventData(EventData ed)
-{
-  evData.emplace(ed.getName(), std::move(ed));
-}
+    for (size_t i = 0; i < summaries->result.size(); ++i) {
+      auto const & key = keyTable->table.names[i];
+      auto const separator = key.find('\0');
+      registry.globalStats[key.substr(0, separator)].dataSummaries[key.substr(separator + 1)] = summaries->result[i];
+    }
+  }
+};
 
 
-void RankData::normalizeTo(sys_clk::time_point t0)
+class EventRegistry::CollectiveFinalize : public Collective
 {
-  auto const delta = initializedAt - t0; // duration that this rank initialized after the first rank
-  assert(t0 <= initializedAt); // t0 should always be before or equal my init time
+public:
+  /// Starts when the request of the duplicate of the communicator made by finalizeAsync completed, if any
+  explicit CollectiveFinalize(EventRegistry & registry, MPI_Request duplicate = MPI_REQUEST_NULL)
+    : registry(registry)
+  {
+    requests.push_back(duplicate);
+  }
 
-  for (auto & events : evData) {
-    for (auto & sc : events.second.stateChanges) {
-      auto & tp = sc.second;
-      tp = stdy_clk::time_point(tp - initializedAtTicks + delta);
-      assert(tp.time_since_epoch().count() > 0); // Trying to do normalize twice?
+private:
+  EventRegistry & registry;
+
+  enum class Stage { START, NORMALIZE, NAMES, REDUCE, GATHER, UNPACK, CLEANUP } stage = Stage::START;
+
+  std::unique_ptr<Normalization> normalization;
+  std::unique_ptr<NameAgreement> names;
+  std::unique_ptr<Reduction> reduction;
+  std::unique_ptr<BufferGather> gathering;
+
+  Step step(bool block) override
+  {
+    switch (stage) {
+    case Stage::START:
+      if (registry.initialized) // this makes only sense when it was properly initialized
+        normalization.reset(new Normalization(registry));
+      stage = Stage::NORMALIZE;
+      // fall through
+    case Stage::NORMALIZE:
+      if (normalization and not normalization->progress(block))
+        return Step::PENDING;
+
+      // One table of names identifies the events in all collectives
+      names.reset(new NameAgreement(registry.getRecordedNames(), registry.comm));
+      stage = Stage::NAMES;
+      // fall through
+    case Stage::NAMES:
+      if (not names->progress(block))
+        return Step::PENDING;
+      reduction.reset(new Reduction(registry, names->table));
+      stage = Stage::REDUCE;
+      // fall through
+    case Stage::REDUCE:
+      if (not reduction->progress(block))
+        return Step::PENDING;
+      stage = Stage::GATHER;
+      // fall through
+    case Stage::GATHER:
+      if (registry.gather == Gather::RANKS) {
+        gathering.reset(new BufferGather(registry.packRankData(names->table, true), registry.comm));
+        stage = Stage::UNPACK;
+        return Step::NEXT;
+      }
+      // Splitting the communicator and MPI-IO block, hence they run when blocking is allowed
+      if ((registry.gather == Gather::NODES or registry.gather == Gather::SHARED_FILE) and not block)
+        return Step::PENDING;
+      if (registry.gather == Gather::FILES)
+        registry.writeFiles();
+      else if (registry.gather == Gather::SHARED_FILE)
+        registry.writeSharedFile(names->table);
+      else if (registry.gather == Gather::NODES)
+        registry.collectNodes(names->table);
+      stage = Stage::CLEANUP;
+      return Step::NEXT;
+
+    case Stage::UNPACK: {
+      if (not gathering->progress(block))
+        return Step::PENDING;
+      auto ranks = unpackRanks(registry, gathering->buffers, names->table);
+      std::move(ranks.begin(), ranks.end(), std::back_inserter(registry.globalRankData));
+      stage = Stage::CLEANUP;
+    }
+    // fall through
+    case Stage::CLEANUP:
+      if (registry.traceSpill) {
+        std::lock_guard<std::mutex> lock(registry.shardsMutex);
+        for (auto & shard : registry.shards)
+          shard->data.stateChanges.setSpill(nullptr);
+        registry.traceSpill.reset();
+      }
+      registry.initialized = false;
+      return Step::LAST;
     }
+    return Step::LAST;
   }
-}
+};
 
-void RankData::clear()
+
+void EventRegistry::finalize()
 {
-  evData.clear();
+  finalizeLocal();
+  CollectiveFinalize(*this).progress(true);
 }
 
-sys_clk::duration RankData::getDuration() const
+void EventRegistry::finalizeAsync()
 {
-  if (isFinalized)
-    return finalizedAt - initializedAt;
-  else
-    return sys_clk::now() - initializedAt;
+  finalizeLocal();
+  asyncPending = true;
+
+  // The duplicate keeps the collectives of the registry apart from those of the application
+  MPI_Request request;
+  userComm = comm;
+  MPI_Comm_idup(userComm, &comm, &request);
+  asyncFinalize.reset(new CollectiveFinalize(*this, request));
+
+  int provided;
+  MPI_Query_thread(&provided);
+  if (provided == MPI_THREAD_MULTIPLE) {
+    finalizingDone = false;
+    finalizing = std::thread([this] {
+        asyncFinalize->progress(true);
+        finalizingDone = true;
+      });
+  }
 }
 
+bool EventRegistry::test()
+{
+  if (finalizing.joinable())
+    return finalizingDone;
+  return not asyncFinalize or asyncFinalize->progress(false);
+}
 
+void EventRegistry::wait()
+{
+  if (finalizing.joinable())
+    finalizing.join();
+  else if (asyncFinalize)
+    asyncFinalize->progress(true);
+
+  if (asyncFinalize) {
+    asyncFinalize.reset();
+    MPI_Comm_free(&comm);
+    comm = userComm;
+  }
+  asyncPending = false;
+}
 
-// -----------------------------------------------------------------------
-
+bool EventRegistry::isFinalizingAsync() const
+{
+  return asyncPending;
+}
 
-EventRegistry & EventRegistry::instance()
+void EventRegistry::setCheckpointInterval(double seconds)
 {
-  static EventRegistry instance;
-  return instance;
+  checkpointInterval = seconds;
 }
 
-void EventRegistry::initialize(std::string applicationName, std::string runName, MPI_Comm comm)
+void EventRegistry::checkpoint()
 {
-  this->applicationName = applicationName;
-  this->runName = runName;
-  this->comm = comm;
+  if (not initialized)
+    return;
 
-  localRankData.initialize();
+  int rank;
+  MPI_Comm_rank(comm, &rank);
 
-  globalEvent.start(false);
-  initialized = true;
+  bool write = true;
+  if (checkpointInterval > 0) {
+    MPI_Wait(&checkpointRequest, MPI_STATUS_IGNORE);
+    write = checkpointDecision;
+  }
+
+  if (write) {
+    mergeShards();
+    normalize();
+    // The segment ends now
+    localRankData.finalizedAt = sys_clk::now();
+    writeSharedFile(agreeOnEventNames());
+
+    // The threads allocate new chunks, hence the written ones are freed and returned to the budget
+    auto const chunks = localRankData.stateChanges.release();
+    if (traceSpill) {
+      traceSpill->clear();
+      traceSpill->release(chunks);
+    }
+    lastCheckpoint = std::chrono::steady_clock::now();
+  }
+
+  // Rank 0 decides for the next checkpoint, the broadcast completes in the meantime
+  if (checkpointInterval > 0) {
+    if (rank == 0)
+      checkpointDecision = std::chrono::steady_clock::now() - lastCheckpoint
+        >= std::chrono::duration<double>(checkpointInterval);
+    MPI_Ibcast(&checkpointDecision, 1, MPI_INT, 0, comm, &checkpointRequest);
+  }
 }
 
-void EventRegistry::finalize()
+void EventRegistry::finalizeLocal()
 {
+  // All ranks started the same number of broadcasts of the checkpoint decision
+  MPI_Wait(&checkpointRequest, MPI_STATUS_IGNORE);
+
   globalEvent.stop();
   localRankData.finalize();
 
   for (auto & e : storedEvents)
     e.second.stop();
 
-  if (initialized) // this makes only sense when it was properly initialized
-    normalize();
-
-  collect();
-
-  initialized = false;
+  mergeShards();
 }
 
 void EventRegistry::clear()
 {
   localRankData.clear();
   globalRankData.clear();
+  globalStats.clear();
   storedEvents.clear();
+  std::lock_guard<std::mutex> lock(shardsMutex);
+  if (traceSpill)
+    traceSpill->clear();
+  for (auto & shard : shards)
+    shard->data.clear();
 }
 
 void EventRegistry::signal_handler(int signal)
@@ -266,7 +1958,118 @@ void EventRegistry::signal_handler(int signal)
 
 void EventRegistry::put(Event const & event)
 {
-  localRankData.put(event);
+  getShard().data.put(event);
+}
+
+void EventRegistry::putStateChange(EventID id, Event::State state, Event::Clock::time_point timestamp)
+{
+  auto & shard = getShard();
+  shard.data.stateChanges.push({state, timestamp, shard.thread, id});
+}
+
+EventID EventRegistry::registerEvent(std::string const & name, int level)
+{
+  // Only names new to the calling thread take the lock
+  auto & shardIDs = getShard().eventIDs;
+  auto const cached = shardIDs.find(name);
+  if (cached != shardIDs.end())
+    return cached->second;
+
+  std::lock_guard<std::mutex> lock(namesMutex);
+  auto insertion = eventIDs.emplace(name, eventNames.size());
+  if (insertion.second) {
+    eventNames.push_back(name);
+    eventLevels.push_back(level);
+    eventRecordings.push_back(-1);
+  }
+
+  shardIDs.emplace(name, insertion.first->second);
+  return insertion.first->second;
+}
+
+void EventRegistry::setLevel(int maxLevel)
+{
+  std::lock_guard<std::mutex> lock(namesMutex);
+  this->maxLevel = maxLevel;
+  ++RecordingTable::settingsVersion;
+}
+
+void EventRegistry::setRecording(Event::Recording recording)
+{
+  std::lock_guard<std::mutex> lock(namesMutex);
+  defaultRecording = recording;
+  ++RecordingTable::settingsVersion;
+}
+
+void EventRegistry::setRecording(EventID id, Event::Recording recording)
+{
+  std::lock_guard<std::mutex> lock(namesMutex);
+  eventRecordings.at(id) = static_cast<int>(recording);
+  ++RecordingTable::settingsVersion;
+}
+
+Event::Recording EventRegistry::getRecording(EventID id)
+{
+  return RecordingTable::get(id);
+}
+
+std::atomic<int> RecordingTable::settingsVersion{0};
+
+Event::Recording RecordingTable::refresh(EventID id)
+{
+  // Owns the copy of the calling thread, the version is read under the lock, as the settings change under it
+  static thread_local std::vector<Event::Recording> copy;
+  auto & registry = EventRegistry::instance();
+  std::lock_guard<std::mutex> lock(registry.namesMutex);
+  copy.resize(registry.eventLevels.size());
+  for (size_t i = 0; i < copy.size(); ++i) {
+    if (registry.eventLevels[i] > registry.maxLevel)
+      copy[i] = Event::Recording::OFF;
+    else if (registry.eventRecordings[i] >= 0)
+      copy[i] = static_cast<Event::Recording>(registry.eventRecordings[i]);
+    else
+      copy[i] = registry.defaultRecording;
+  }
+  local() = {copy.data(), copy.size(), settingsVersion.load(std::memory_order_relaxed)};
+  return copy[id];
+}
+
+std::string const & EventRegistry::getEventName(EventID id) const
+{
+  std::lock_guard<std::mutex> lock(namesMutex);
+  assert(id >= 0 and static_cast<size_t>(id) < eventNames.size());
+  return eventNames[id];
+}
+
+std::vector<std::string> EventRegistry::getEventNames() const
+{
+  std::lock_guard<std::mutex> lock(namesMutex);
+  return {eventNames.begin(), eventNames.end()};
+}
+
+int EventRegistry::getThreadID()
+{
+  return getShard().thread;
+}
+
+EventRegistry::ThreadShard & EventRegistry::getShard()
+{
+  if (not localShard) {
+    std::lock_guard<std::mutex> lock(shardsMutex);
+    shards.emplace_back(new ThreadShard(shards.size()));
+    localShard = shards.back().get();
+    localShard->data.stateChanges.setSpill(traceSpill.get());
+  }
+  return *localShard;
+}
+
+void EventRegistry::mergeShards()
+{
+  std::lock_guard<std::mutex> lock(shardsMutex);
+  for (auto & shard : shards) {
+    localRankData.merge(std::move(shard->data));
+    shard->data.clear();
+  }
 }
 
 Event & EventRegistry::getStoredEvent(std::string const & name)
@@ -274,6 +2077,7 @@ Event & EventRegistry::getStoredEvent(std::string const & name)
   // Reset the prefix for creation of a stored event. Using prefixes with stored events is possible
   // but leads to unexpected results, such as not getting the event you want, because someone else up the
   // stack set a prefix.
+  std::lock_guard<std::mutex> lock(storedEventsMutex);
   auto previousPrefix = prefix;
   prefix = "";
   auto insertion = storedEvents.emplace(std::piecewise_construct,
@@ -293,15 +2097,25 @@ void EventRegistry::printAll()
   if (myRank != 0)
     return;
 
-  std::string logFile;
-  if (applicationName.empty())
-    logFile = "Events.json";
-  else
-    logFile = applicationName + "-events.json";
+  std::string const base = applicationName.empty() ? "Events" : applicationName + "-events";
 
   writeSummary(std::cout);
-  std::ofstream ofs(logFile);
+
+  // The data has already been written by each rank at finalize
+  if (gather == Gather::FILES or gather == Gather::SHARED_FILE)
+    return;
+
+  std::ofstream ofs(base + ".json");
   writeJSON(ofs);
+
+  if (traceFormat == TraceFormat::CHROME) {
+    std::ofstream trace(base + ".trace.json");
+    writeTrace(trace);
+  }
+  else if (traceFormat == TraceFormat::PERFETTO) {
+    std::ofstream trace(base + ".pftrace", std::ios::binary);
+    writePerfetto(trace);
+  }
 }
 
 
@@ -315,51 +2129,118 @@ void EventRegistry::writeSummary(std::ostream &out)
     using std::endl;
     { // Print per event stats
       std::time_t ts = sys_clk::to_time_t(localRankData.finalizedAt);
-      double const duration = std::chrono::duration_cast<std::chrono::milliseconds>(localRankData.getDuration()).count();
+      double const duration = std::chrono::duration_cast<std::chrono::nanoseconds>(localRankData.getDuration()).count();
     
       out << "Run finished at " << std::asctime(std::localtime(&ts));
 
       out << "Global runtime       = "
-          << duration << "ms / "
-          << duration / 1000 << "s" << endl
+          << duration / 1e6 << "ms / "
+          << duration / 1e9 << "s" << endl
           << "Number of processors = " << size << endl
           << "# Rank: " << rank << endl << endl;
 
+      auto const events = localRankData.getEvents();
+      long maxTotal = 0, maxMax = 0, maxMin = 0, maxAvg = 0, maxP99 = 0;
+      for (auto const * e : events) {
+        maxTotal = std::max(maxTotal, e->getTotal());
+        maxMax = std::max(maxMax, e->getMax());
+        maxMin = std::max(maxMin, e->getMin());
+        maxAvg = std::max(maxAvg, e->getAvg());
+        maxP99 = std::max(maxP99, e->getPercentile(99));
+      }
+      auto const totalUnit = selectUnit(maxTotal), maxUnit = selectUnit(maxMax),
+        minUnit = selectUnit(maxMin), avgUnit = selectUnit(maxAvg), pUnit = selectUnit(maxP99);
+
       Table table(out);
       table.addColumn("Event", getMaxNameWidth());
       table.addColumn("Count", 10);
-      table.addColumn("Total[ms]", 10);
-      table.addColumn("Max[ms]", 10);
-      table.addColumn("Min[ms]", 10);
-      table.addColumn("Avg[ms]", 10);
+      table.addColumn("Total[" + totalUnit.name + "]", 10);
+      table.addColumn("Max[" + maxUnit.name + "]", 10);
+      table.addColumn("Min[" + minUnit.name + "]", 10);
+      table.addColumn("Avg[" + avgUnit.name + "]", 10);
+      table.addColumn("P50[" + pUnit.name + "]", 10);
+      table.addColumn("P95[" + pUnit.name + "]", 10);
+      table.addColumn("P99[" + pUnit.name + "]", 10);
       table.addColumn("Time Ratio", 6, 3);
       table.printHeader();
     
-      for (auto & e : localRankData.evData) {
-        auto & ev = e.second;
-        table.printRow(ev.getName(), ev.getCount(), ev.getTotal(), ev.getMax(),  ev.getMin(), ev.getAvg(),
+      for (auto const * e : events) {
+        auto & ev = *e;
+        table.printRow(ev.getName(), ev.getCount(), ev.getTotal() / totalUnit.nanoseconds,
+                       ev.getMax() / maxUnit.nanoseconds, ev.getMin() / minUnit.nanoseconds,
+                       ev.getAvg() / avgUnit.nanoseconds, ev.getPercentile(50) / pUnit.nanoseconds,
+                       ev.getPercentile(95) / pUnit.nanoseconds, ev.getPercentile(99) / pUnit.nanoseconds,
                        divOrZero(ev.getTotal(), duration));
       }
     }
     out << endl << endl;
     { // Print aggregated states
+      auto const & stats = globalStats;
+      long maxMax = 0, maxMin = 0, maxAvg = 0, maxP99 = 0;
+      size_t nameWidth = 0;
+      for (auto & e : stats) {
+        maxMax = std::max(maxMax, static_cast<long>(e.second.max.count()));
+        maxMin = std::max(maxMin, static_cast<long>(e.second.min.count()));
+        maxAvg = std::max(maxAvg, e.second.getAvg());
+        maxP99 = std::max(maxP99, e.second.getPercentile(99));
+        nameWidth = std::max(nameWidth, e.first.size());
+      }
+      auto const maxUnit = selectUnit(maxMax), minUnit = selectUnit(maxMin), avgUnit = selectUnit(maxAvg),
+        pUnit = selectUnit(maxP99);
+
       Table t(out);
-      t.addColumn("Name", getMaxNameWidth());
-      t.addColumn("Max", 10);
+      t.addColumn("Name", nameWidth);
+      t.addColumn("Count", 10);
+      t.addColumn("Avg[" + avgUnit.name + "]", 10);
+      t.addColumn("StdDev[" + avgUnit.name + "]", 11);
+      t.addColumn("Max[" + maxUnit.name + "]", 10);
       t.addColumn("MaxOnRank", 10);
-      t.addColumn("Min", 10);
+      t.addColumn("Min[" + minUnit.name + "]", 10);
       t.addColumn("MinOnRank", 10);
       t.addColumn("Min/Max", 10);
+      t.addColumn("P50[" + pUnit.name + "]", 10);
+      t.addColumn("P95[" + pUnit.name + "]", 10);
+      t.addColumn("P99[" + pUnit.name + "]", 10);
       t.printHeader();
 
-      auto stats = getGlobalStats(globalRankData);
       for (auto & e : stats) {
         auto & ev = e.second;
         double rel = 0;
-        if (ev.max != stdy_clk::duration::zero()) // Guard against division by zero
+        if (ev.max != Event::Clock::duration::zero()) // Guard against division by zero
           rel = static_cast<double>(ev.min.count()) / ev.max.count();
       
-        t.printRow(e.first, ev.max, ev.maxRank, ev.min, ev.minRank, rel);
+        t.printRow(e.first, ev.count, ev.getAvg() / avgUnit.nanoseconds, ev.getStdDev() / avgUnit.nanoseconds,
+                   ev.max.count() / maxUnit.nanoseconds, ev.maxRank,
+                   ev.min.count() / minUnit.nanoseconds, ev.minRank, rel,
+                   ev.getPercentile(50) / pUnit.nanoseconds, ev.getPercentile(95) / pUnit.nanoseconds,
+                   ev.getPercentile(99) / pUnit.nanoseconds);
+      }
+
+      // Print summaries of summary-only data on all ranks
+      size_t keyWidth = 0;
+      for (auto & e : stats)
+        for (auto & d : e.second.dataSummaries)
+          keyWidth = std::max(keyWidth, d.first.size());
+
+      if (keyWidth > 0) {
+        out << endl << endl;
+        Table dt(out);
+        dt.addColumn("Name", nameWidth);
+        dt.addColumn("Data", std::max<size_t>(keyWidth, 4));
+        dt.addColumn("Count", 10);
+        dt.addColumn("Min", 10);
+        dt.addColumn("Max", 10);
+        dt.addColumn("Sum", 10);
+        dt.addColumn("Mean", 10);
+        dt.addColumn("StdDev", 10);
+        dt.printHeader();
+
+        for (auto & e : stats)
+          for (auto & d : e.second.dataSummaries) {
+            auto & sum = d.second;
+            dt.printRow(e.first, d.first, sum.count, sum.min, sum.max, sum.getSum(), sum.mean,
+                        std::sqrt(sum.getVariance()));
+          }
       }
     }
   }
@@ -368,191 +2249,306 @@ void EventRegistry::writeSummary(std::ostream &out)
 
 void EventRegistry::writeJSON(std::ostream & out)
 {
-  using json = nlohmann::json;
-  using namespace std::chrono;
+  sys_clk::time_point initT = localRankData.initializedAt, finalT = localRankData.finalizedAt;
+  if (not globalRankData.empty())
+    std::tie(initT, finalT) = findFirstAndLastTime();
+
+  // Written rank by rank, without a document of all ranks in memory
+  JSONWriter json(out);
+  json.beginObject();
+  json.key("Finalized").value(timepoint_to_string(finalT));
+  json.key("Initialized").value(timepoint_to_string(initT));
+  json.key("Name").value(runName);
+  json.key("Ranks").beginArray();
+  auto const names = getEventNames();
+  for (auto const & rank : globalRankData)
+    writeRankJSON(json, rank, names);
+  json.endArray();
+  json.endObject();
+  out << std::endl;
+}
+
+void EventRegistry::writeTrace(std::ostream & out, int pid)
+{
+  sys_clk::time_point initT = localRankData.initializedAt, finalT = localRankData.finalizedAt;
+  if (not globalRankData.empty())
+    std::tie(initT, finalT) = findFirstAndLastTime();
+
+  JSONWriter json(out);
+  json.beginObject();
+  json.key("displayTimeUnit").value("ns");
+  json.key("otherData").beginObject();
+  json.key("Finalized").value(timepoint_to_string(finalT));
+  json.key("Initialized").value(timepoint_to_string(initT));
+  json.key("Name").value(runName);
+  json.endObject();
+
+  json.key("traceEvents").beginArray();
+  writeTraceMetadata(json, "process_name", pid, 0, "name", applicationName.empty() ? "Events" : applicationName);
+  auto const names = getEventNames();
+  for (std::size_t rank = 0; rank < globalRankData.size(); ++rank)
+    writeTraceEvents(json, globalRankData[rank], names, pid, rank);
+  json.endArray();
+  json.endObject();
+  out << std::endl;
+}
+
+void EventRegistry::writePerfetto(std::ostream & out, int pid)
+{
+  // The threads of all ranks share one range of sequences
+  std::uint64_t sequenceCount = 0;
+  writePerfettoProcess(out, pid, applicationName.empty() ? "Events" : applicationName);
+  auto const names = getEventNames();
+  for (std::size_t rank = 0; rank < globalRankData.size(); ++rank)
+    writePerfettoPackets(out, globalRankData[rank], names, pid, rank, sequenceCount);
+  out.flush();
+}
 
-  json js;
-
-  sys_clk::time_point initT, finalT;
-  std::tie(initT, finalT) = findFirstAndLastTime();
-  js["Name"] = runName;
-  js["Initialized"] = timepoint_to_string(initT);
-  js["Finalized"] = timepoint_to_string(finalT);
-
-  for (auto const & rank : globalRankData) {
-    auto jTimings = json::object();
-    auto jStateChanges = json::array();
-    double const duration = duration_cast<milliseconds>(rank.getDuration()).count();
-    for (auto const & events : rank.evData) {
-      auto const & e = events.second;
-      jTimings[events.second.getName()] = {
-        {"Count", e.getCount()},
-        {"Total", e.getTotal()},
-        {"Max", e.getMax()},
-        {"Min", e.getMin()},
-        {"TimeRatio", divOrZero(e.getTotal(), duration)},
-        {"Data" , e.getData()}
-      };
-      for (auto const & sc : e.stateChanges) {
-        jStateChanges.push_back({
-            {"Name", events.second.getName()},
-            {"State", sc.first},
-            {"Timestamp", duration_cast<milliseconds>(sc.second.time_since_epoch()).count()}
+void EventRegistry::writeFiles()
+{
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  std::string const base = applicationName.empty() ? "Events" : applicationName + "-events";
+
+  // Each rank writes its own data, including the state changes written to disk
+  {
+    std::ofstream out(base + "." + std::to_string(rank) + ".json");
+    JSONWriter json(out);
+    json.beginObject();
+    json.key("Finalized").value(timepoint_to_string(localRankData.finalizedAt));
+    json.key("Initialized").value(timepoint_to_string(localRankData.initializedAt));
+    json.key("Name").value(runName);
+    json.key("Ranks").beginArray();
+    auto const names = getEventNames();
+    writeRankJSON(json, localRankData, names, [&] {
+        if (not traceSpill)
+          return;
+        traceSpill->flush();
+        traceSpill->read([&](Event::StateChange const & sc) {
+            auto normalized = sc;
+            normalized.timestamp = localRankData.normalize(sc.timestamp);
+            writeStateChangeJSON(json, normalized, names);
           });
-      }
-    }
-    js["Ranks"].push_back({
-        {"Finalized", timepoint_to_string(rank.finalizedAt)},
-        {"Initialized", timepoint_to_string(rank.initializedAt)},
-        {"Timings", jTimings},
-        {"StateChanges", jStateChanges}
       });
+    json.endArray();
+    json.endObject();
+    out << std::endl;
+  }
+
+  // Rank 0 writes an index of all files with the first initialized and last finalized time
+  auto const times = collectInitAndFinalize();
+  if (rank != 0)
+    return;
+
+  std::ofstream out(base + ".index.json");
+  JSONWriter json(out);
+  json.beginObject();
+  json.key("Finalized").value(timepoint_to_string(times.second));
+  json.key("Files").beginArray();
+  for (int r = 0; r < size; ++r)
+    json.value(base + "." + std::to_string(r) + ".json");
+  json.endArray();
+  json.key("Initialized").value(timepoint_to_string(times.first));
+  json.key("Name").value(runName);
+  json.endObject();
+  out << std::endl;
+}
+
+
+void EventRegistry::writeSharedFile(NameTable const & names)
+{
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  std::string const filename = (applicationName.empty() ? "Events" : applicationName + "-events") + ".bin";
+
+  auto const data = packRankData(names, true);
+
+  // Rank 0 prepends the header, the name table and the offset table, the others need their size for their offset.
+  // Offsets are relative to the file, which may already hold segments of checkpoints.
+  PackBuffer header;
+  std::uint64_t headerSize = 0;
+  if (rank == 0) {
+    header.pack(sharedFileMagic, sizeof(sharedFileMagic));
+    header.pack(sharedFileVersion);
+    header.pack(static_cast<std::uint64_t>(size));
+    header.pack(runName);
+    header.pack(names.names.size());
+    for (auto const & name : names.names)
+      header.pack(name);
+    headerSize = header.data.size() + 3 * size * sizeof(std::uint64_t);
+  }
+  MPI_Bcast(&headerSize, 1, MPI_UINT64_T, 0, comm);
+
+  std::uint64_t const bytes = data.size();
+  std::uint64_t offset = 0;
+  MPI_Exscan(&bytes, &offset, 1, MPI_UINT64_T, MPI_SUM, comm);
+  if (rank == 0) // Exscan leaves it undefined
+    offset = 0;
+  offset += sharedFileSize + headerSize;
+
+  // The offset table holds offset, size and number of state changes of the section of each rank.
+  // The state changes are at the end of a section, so readers can find them without parsing it.
+  std::uint64_t const stateChanges = localRankData.stateChanges.size() + (traceSpill ? traceSpill->size() : 0);
+  std::uint64_t const entry[3] = {offset, bytes, stateChanges};
+  std::vector<std::uint64_t> table(rank == 0 ? 3 * size : 0);
+  MPI_Gather(entry, 3, MPI_UINT64_T, table.data(), 3, MPI_UINT64_T, 0, comm);
+
+  // The section of rank 0 directly follows its header, hence it writes both at once
+  std::vector<char> out;
+  if (rank == 0) {
+    header.pack(table.data(), table.size());
+    out = std::move(header.data);
+    offset = sharedFileSize;
+  }
+  out.insert(out.end(), data.begin(), data.end());
+
+  MPI_File file;
+  if (MPI_File_open(comm, filename.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+    if (rank == 0)
+      std::cerr << "Could not open " << filename << " for writing the events" << std::endl;
+    return;
   }
-  
-  out << std::setw(2) << js << std::endl;
+  if (sharedFileSize == 0)
+    MPI_File_set_size(file, 0);
+
+  // The count of a write is an int, larger sections are written in several collective rounds
+  std::uint64_t const maxBytes = std::numeric_limits<int>::max();
+  std::uint64_t rounds = (out.size() + maxBytes - 1) / maxBytes;
+  MPI_Allreduce(MPI_IN_PLACE, &rounds, 1, MPI_UINT64_T, MPI_MAX, comm);
+  std::uint64_t written = 0;
+  for (std::uint64_t i = 0; i < rounds; ++i) {
+    auto const n = std::min<std::uint64_t>(out.size() - written, maxBytes);
+    MPI_File_write_at_all(file, offset + written, out.data() + written, static_cast<int>(n),
+                          MPI_BYTE, MPI_STATUS_IGNORE);
+    written += n;
+  }
+  MPI_File_close(&file);
+
+  std::uint64_t segmentSize = out.size();
+  MPI_Allreduce(MPI_IN_PLACE, &segmentSize, 1, MPI_UINT64_T, MPI_SUM, comm);
+  sharedFileSize += segmentSize;
 }
 
 
 MPI_Comm const & EventRegistry::getMPIComm() const
 {
+  // comm is replaced by a duplicate, which the collectives of finalizeAsync use
+  if (asyncPending)
+    throw std::logic_error("The communicator of the events is not available between finalizeAsync and wait");
   return comm;
 }
 
 
-void EventRegistry::collect()
+std::vector<std::string> EventRegistry::getRecordedNames()
 {
-  // Register MPI datatype
-  MPI_Datatype MPI_EVENTDATA;
-  int blocklengths[] = {255, 1, 3, 2};
-  MPI_Aint displacements[] = {offsetof(MPI_EventData, name), offsetof(MPI_EventData, count),
-                              offsetof(MPI_EventData, total), offsetof(MPI_EventData, dataSize)};
-  MPI_Datatype types[] = {MPI_CHAR, MPI_INT, MPI_LONG, MPI_INT};
-  MPI_Type_create_struct(4, blocklengths, displacements, types, &MPI_EVENTDATA);
-  MPI_Type_commit(&MPI_EVENTDATA);
+  // Make sure all events that changed their state have an EventData, so their name is in the table
+  if (traceSpill) {
+    traceSpill->flush();
+    traceSpill->read([this](Event::StateChange const & sc) { localRankData.getEventData(sc.id); });
+  }
+  for (auto const & sc : localRankData.stateChanges)
+    localRankData.getEventData(sc.id);
 
-  int rank, MPIsize;
-  MPI_Comm_rank(comm, &rank);
-  MPI_Comm_size(comm, &MPIsize);
+  std::vector<std::string> names;
+  for (auto const & ev : localRankData.evData)
+    names.push_back(ev.getName());
+  return names;
+}
 
-  std::vector<MPI_Request> requests;
-  std::vector<int> eventsPerRank(MPIsize);
-  size_t eventsSize = localRankData.evData.size();
-  MPI_Gather(&eventsSize, 1, MPI_INT, eventsPerRank.data(), 1, MPI_INT, 0, comm);
-
-  std::vector<MPI_EventData> eventSendBuf(eventsSize);
-  std::vector<std::vector<long>> stateChangesBuf(eventsSize);
-  int i = 0;
-
-  MPI_Request req;
-  
-  // Send the times from the local RankData
-  std::array<long, 2> times= {localRankData.initializedAt.time_since_epoch().count(),
-                              localRankData.finalizedAt.time_since_epoch().count()};
-  MPI_Isend(&times, times.size(), MPI_LONG, 0, 0, comm, &req);
-  requests.push_back(req);  
-
-  // Send all events from all ranks, including rank 0, to rank 0
-  for (auto const & evData : localRankData.evData) {
-    const auto & ev = evData.second;
-    MPI_EventData eventdata;
-
-    // Send aggregated EventData
-    assert(evData.first.size() <= sizeof(eventdata.name));
-    evData.first.copy(eventSendBuf[i].name, sizeof(eventdata.name));
-    eventSendBuf[i].count = ev.getCount();
-    eventSendBuf[i].total = ev.getTotal();
-    eventSendBuf[i].max = ev.getMax();
-    eventSendBuf[i].min = ev.getMin();
-    eventSendBuf[i].dataSize = ev.getData().size();
-    eventSendBuf[i].stateChangesSize = ev.stateChanges.size();
-    MPI_Isend(&eventSendBuf[i], 1, MPI_EVENTDATA, 0, 0, comm, &req);
-    requests.push_back(req);
-    
-    // Send the state changes 
-    for (auto const & sc : ev.stateChanges) {
-      stateChangesBuf[i].push_back(static_cast<long>(sc.first)); // state
-      stateChangesBuf[i].push_back(
-        std::chrono::duration_cast<std::chrono::milliseconds>(sc.second.time_since_epoch()).count());
-    }
-    MPI_Isend(stateChangesBuf[i].data(), ev.stateChanges.size() * 2, MPI_LONG, 0, 0, comm, &req);
-    requests.push_back(req);
-
-    // Send the map that stores the data associated with an event
-    for (auto const & md : ev.getData()) {
-      auto & key = std::get<0>(md);
-      auto & val = std::get<1>(md);
-      MPI_Isend(key.c_str(), key.size(), MPI_CHAR, 0, 0, comm, &req);
-      requests.push_back(req);
-      MPI_Isend(val.data(), val.size(), MPI_INT, 0, 0, comm, &req);
-      requests.push_back(req);
-    }
-    
-    ++i;
-  }
 
-  // Receive
-  if (rank == 0) {
-    for (int i = 0; i < MPIsize; ++i) {
-      RankData data;
-      // Receive initialized and finalized times
-      std::array<long, 2> recvTimes;
-      MPI_Recv(&recvTimes, 2, MPI_LONG, i, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
-      data.initializedAt = sys_clk::time_point(sys_clk::duration(recvTimes[0]));
-      data.finalizedAt = sys_clk::time_point(sys_clk::duration(recvTimes[1]));
-
-      // Receive all events from this rank
-      for (int j = 0; j < eventsPerRank[i]; ++j) {
-        // Receive aggregated EventData
-        MPI_EventData ev;
-        MPI_Recv(&ev, 1, MPI_EVENTDATA, i, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
-
-        // Receive all state changes for this event
-        std::vector<long> recvStateChanges(ev.stateChangesSize * 2);
-        MPI_Recv(recvStateChanges.data(), recvStateChanges.size(),
-                 MPI_LONG, i, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
-        Event::StateChanges stateChanges; // evtl. reserve
-        for (size_t i = 0; i < recvStateChanges.size(); i += 2) {
-          stateChanges.emplace_back(static_cast<Event::State>(recvStateChanges[i]),
-                                    stdy_clk::time_point(std::chrono::milliseconds(recvStateChanges[i+1])));
-        }
+NameTable EventRegistry::agreeOnEventNames()
+{
+  return agreeOnNames(getRecordedNames(), comm);
+}
 
-        // Receive the map that stores the data associated with an event
-        Event::Data dataMap;
-        for (int j = 0; j < ev.dataSize; j++) {
-          MPI_Status status;
-          int count = 0;
-          MPI_Probe(i, MPI_ANY_TAG, comm, &status);
-          MPI_Get_count(&status, MPI_CHAR, &count);
-          std::string key(count, '\0');
-          MPI_Recv(&key[0], count, MPI_CHAR, i, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
-          MPI_Probe(i, MPI_ANY_TAG, comm, &status);
-          MPI_Get_count(&status, MPI_INT, &count);
-          std::vector<int> val(count);
-          MPI_Recv(val.data(), count, MPI_INT, i, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
-          dataMap[key] = val;
-        }
 
-        // Create the EventData
-        EventData ed(ev.name, ev.count, ev.total, ev.max, ev.min, dataMap, stateChanges);
-        data.addEventData(std::move(ed));
-      }
-      globalRankData.push_back(data);      
+std::vector<char> EventRegistry::packRankData(NameTable const & names, bool withStateChanges)
+{
+  // Events are identified by their index in the table, each name is sent only once
+  std::size_t spilled = 0;
+  if (traceSpill) {
+    traceSpill->flush();
+    spilled = traceSpill->size();
+  }
+  std::vector<std::uint32_t> globalIDs;
+  for (auto const & ev : localRankData.evData)
+    globalIDs.push_back(names.indexOf(ev.getName()));
+
+  // Pack all data of this rank into a single buffer
+  PackBuffer sendBuf;
+  sendBuf.pack(localRankData.initializedAt.time_since_epoch().count());
+  sendBuf.pack(localRankData.finalizedAt.time_since_epoch().count());
+  sendBuf.pack(std::count_if(localRankData.evData.begin(), localRankData.evData.end(),
+                             [](EventData const & ev) { return ev.getCount() > 0; }));
+  for (EventID id = 0; id < static_cast<EventID>(localRankData.evData.size()); ++id)
+    if (localRankData.evData[id].getCount() > 0)
+      pack(sendBuf, globalIDs[id], localRankData.evData[id]);
+
+  // The state changes, starting with those written to disk, which are not normalized yet
+  if (withStateChanges) {
+    sendBuf.pack(spilled + localRankData.stateChanges.size());
+    if (traceSpill)
+      traceSpill->read([&](Event::StateChange const & sc) {
+          auto global = sc;
+          global.id = globalIDs[sc.id];
+          global.timestamp = localRankData.normalize(sc.timestamp);
+          pack(sendBuf, global);
+        });
+    for (auto const & sc : localRankData.stateChanges) {
+      auto global = sc;
+      global.id = globalIDs[sc.id];
+      pack(sendBuf, global);
     }
   }
-  MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
-  MPI_Type_free(&MPI_EVENTDATA);
+  else {
+    sendBuf.pack(std::size_t(0));
+  }
+  return std::move(sendBuf.data);
 }
 
 
-void EventRegistry::normalize()
+void EventRegistry::collectNodes(NameTable const & names)
 {
-  long ticks = localRankData.initializedAt.time_since_epoch().count();
-  long minTicks;
-  MPI_Allreduce(&ticks, &minTicks, 1, MPI_LONG, MPI_MIN, EventRegistry::instance().getMPIComm());
+  int rank;
+  MPI_Comm_rank(comm, &rank);
 
-  // This assumes the same epoch and ticks rep, should be true for system time
-  sys_clk::time_point t0{sys_clk::duration{minTicks}};
-  localRankData.normalizeTo(t0);
+  // State changes are not gathered per node, the trace of a node would be meaningless
+  PackBuffer sendBuf;
+  sendBuf.data = packRankData(names, false);
+
+  // Merge the data of each shared memory node at its first rank, which are the only ones to send to rank 0
+  MPI_Comm nodeComm, gatherComm;
+  int nodeRank;
+  MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &nodeComm);
+  MPI_Comm_rank(nodeComm, &nodeRank);
+
+  BufferGather node(std::move(sendBuf.data), nodeComm);
+  node.progress(true);
+  MPI_Comm_free(&nodeComm);
+  if (nodeRank == 0)
+    sendBuf = mergeBuffers(std::move(node.buffers));
+
+  MPI_Comm_split(comm, nodeRank == 0 ? 0 : MPI_UNDEFINED, rank, &gatherComm);
+  if (gatherComm == MPI_COMM_NULL)
+    return;
+
+  BufferGather nodes(std::move(sendBuf.data), gatherComm);
+  nodes.progress(true);
+  MPI_Comm_free(&gatherComm);
+
+  if (rank != 0)
+    return;
+
+  auto ranks = unpackRanks(*this, nodes.buffers, names);
+  std::move(ranks.begin(), ranks.end(), std::back_inserter(globalRankData));
+}
+
+
+void EventRegistry::normalize()
+{
+  Normalization(*this).progress(true);
 }
 
 std::pair<sys_clk::time_point, sys_clk::time_point>
@@ -560,11 +2556,11 @@ EventRegistry::collectInitAndFinalize()
 {
   long ticks = localRankData.initializedAt.time_since_epoch().count();
   long minTicks;
-  MPI_Reduce(&ticks, &minTicks, 1, MPI_LONG, MPI_MIN, 0, EventRegistry::instance().getMPIComm());
+  MPI_Reduce(&ticks, &minTicks, 1, MPI_LONG, MPI_MIN, 0, comm);
 
   ticks = localRankData.finalizedAt.time_since_epoch().count();
   long maxTicks;
-  MPI_Reduce(&ticks, &maxTicks, 1, MPI_LONG, MPI_MAX, 0, EventRegistry::instance().getMPIComm());
+  MPI_Reduce(&ticks, &maxTicks, 1, MPI_LONG, MPI_MAX, 0, comm);
 
   // This assumes the same epoch and ticks rep, should be true for system time
 
@@ -577,8 +2573,8 @@ size_t EventRegistry::getMaxNameWidth()
 {
   size_t maxEventWidth = 0;
   for (auto & ev : localRankData.evData)
-    if (ev.second.getName().size() > maxEventWidth)
-      maxEventWidth = ev.second.getName().size();
+    if (ev.getName().size() > maxEventWidth)
+      maxEventWidth = ev.getName().size();
 
   return maxEventWidth;
 }
@@ -0,0 +1,106 @@
+#include "EventTimings/Histogram.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace EventTimings {
+
+constexpr int Histogram::subBuckets;
+constexpr int Histogram::maxExponent;
+constexpr int Histogram::buckets;
+constexpr int Histogram::subBucketBits;
+
+
+void Histogram::add(int index, std::uint64_t count)
+{
+  assert(index >= 0 and index < buckets);
+  if (index < offset or index >= offset + static_cast<int>(counts.size()))
+    grow(index);
+  counts[index - offset] += count;
+}
+
+void Histogram::merge(Histogram const & other)
+{
+  if (other.counts.empty())
+    return;
+  grow(other.offset);
+  grow(other.offset + other.counts.size() - 1);
+  for (size_t i = 0; i < other.counts.size(); ++i)
+    counts[other.offset - offset + i] += other.counts[i];
+}
+
+std::uint64_t Histogram::getCount() const
+{
+  std::uint64_t count = 0;
+  for (auto c : counts)
+    count += c;
+  return count;
+}
+
+long Histogram::getPercentile(double percentage) const
+{
+  auto const count = getCount();
+  if (count == 0)
+    return 0;
+
+  // Number of values that are below or equal to the percentile, at least one
+  auto const rank = std::max<std::uint64_t>(1, std::ceil(percentage / 100 * count));
+  std::uint64_t seen = 0;
+  for (size_t i = 0; i < counts.size(); ++i) {
+    seen += counts[i];
+    if (seen >= rank) {
+      int const index = offset + i;
+      return (getBucketLowerBound(index) + getBucketUpperBound(index) - 1) / 2;
+    }
+  }
+  return getBucketLowerBound(offset + counts.size() - 1);
+}
+
+std::vector<std::pair<int, std::uint64_t>> Histogram::getBuckets() const
+{
+  std::vector<std::pair<int, std::uint64_t>> nonEmpty;
+  for (size_t i = 0; i < counts.size(); ++i)
+    if (counts[i] > 0)
+      nonEmpty.emplace_back(offset + i, counts[i]);
+  return nonEmpty;
+}
+
+void Histogram::clear()
+{
+  counts.clear();
+  offset = 0;
+}
+
+long Histogram::getBucketLowerBound(int index)
+{
+  if (index < subBuckets)
+    return index;
+  int const exponent = index / subBuckets + subBucketBits - 1;
+  return static_cast<long>(subBuckets + index % subBuckets) << (exponent - subBucketBits);
+}
+
+long Histogram::getBucketUpperBound(int index)
+{
+  if (index < subBuckets)
+    return index + 1;
+  int const exponent = index / subBuckets + subBucketBits - 1;
+  return getBucketLowerBound(index) + (1l << (exponent - subBucketBits));
+}
+
+void Histogram::grow(int index)
+{
+  if (counts.empty()) {
+    offset = index;
+    counts.resize(1, 0);
+  }
+  else if (index < offset) {
+    counts.insert(counts.begin(), offset - index, 0);
+    offset = index;
+  }
+  else if (index >= offset + static_cast<int>(counts.size())) {
+    counts.resize(index - offset + 1, 0);
+  }
+}
+
+}
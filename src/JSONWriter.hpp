@@ -0,0 +1,221 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace EventTimings {
+
+/// Writes compact JSON directly to a stream, without building a document in memory.
+/** Commas between elements are inserted automatically. A member of an object is written as a key
+followed by a value or the begin of an array or object. The output is buffered in small blocks,
+which are passed to the stream when full and when the outermost array or object is closed. */
+class JSONWriter
+{
+public:
+  explicit JSONWriter(std::ostream & out)
+    : out(out)
+  {
+    buffer.reserve(blockSize);
+  }
+
+  JSONWriter(const JSONWriter & other) = delete;
+
+  ~JSONWriter()
+  {
+    flush();
+  }
+
+  /// Passes the buffered output to the stream
+  void flush()
+  {
+    out.write(buffer.data(), buffer.size());
+    buffer.clear();
+  }
+
+  JSONWriter & beginObject()
+  {
+    separate();
+    put('{');
+    first.push_back(true);
+    return *this;
+  }
+
+  JSONWriter & endObject()
+  {
+    first.pop_back();
+    put('}');
+    if (first.empty())
+      flush();
+    return *this;
+  }
+
+  JSONWriter & beginArray()
+  {
+    separate();
+    put('[');
+    first.push_back(true);
+    return *this;
+  }
+
+  JSONWriter & endArray()
+  {
+    first.pop_back();
+    put(']');
+    if (first.empty())
+      flush();
+    return *this;
+  }
+
+  JSONWriter & key(std::string const & name)
+  {
+    separate();
+    writeString(name);
+    put(':');
+    afterKey = true;
+    return *this;
+  }
+
+  JSONWriter & value(long long v)
+  {
+    separate();
+    // Digits are written backwards from the end of the buffer
+    char digits[24];
+    char * const end = digits + sizeof(digits);
+    char * pos = end;
+    unsigned long long u = v < 0 ? 0ull - static_cast<unsigned long long>(v) : v;
+    do {
+      *--pos = static_cast<char>('0' + u % 10);
+      u /= 10;
+    } while (u > 0);
+    if (v < 0)
+      *--pos = '-';
+    write(pos, end - pos);
+    return *this;
+  }
+
+  JSONWriter & value(long v) { return value(static_cast<long long>(v)); }
+
+  JSONWriter & value(int v) { return value(static_cast<long long>(v)); }
+
+  /// Writes the shortest representation that reads back exactly, or null if v is not finite
+  JSONWriter & value(double v)
+  {
+    separate();
+    if (not std::isfinite(v)) {
+      write("null", 4);
+      return *this;
+    }
+    char digits[32];
+    int n = std::snprintf(digits, sizeof(digits), "%.15g", v);
+    if (std::strtod(digits, nullptr) != v)
+      n = std::snprintf(digits, sizeof(digits), "%.17g", v);
+    write(digits, n);
+    return *this;
+  }
+
+  JSONWriter & value(bool v)
+  {
+    separate();
+    if (v)
+      write("true", 4);
+    else
+      write("false", 5);
+    return *this;
+  }
+
+  JSONWriter & value(std::string const & v)
+  {
+    separate();
+    writeString(v);
+    return *this;
+  }
+
+  JSONWriter & value(char const * v) { return value(std::string(v)); }
+
+  /// Writes all values as an array
+  template<typename T>
+  JSONWriter & value(std::vector<T> const & values)
+  {
+    beginArray();
+    for (auto const & v : values)
+      value(v);
+    return endArray();
+  }
+
+private:
+  void put(char c)
+  {
+    buffer.push_back(c);
+  }
+
+  void write(char const * s, std::size_t n)
+  {
+    buffer.append(s, n);
+    if (buffer.size() >= blockSize)
+      flush();
+  }
+
+  /// Writes a comma, unless this is the first element of an array or object or the value of a key
+  void separate()
+  {
+    if (afterKey) {
+      afterKey = false;
+      return;
+    }
+    if (first.empty())
+      return;
+    if (first.back())
+      first.back() = false;
+    else
+      put(',');
+  }
+
+  /// Writes a quoted string, escaping quotes, backslashes and control characters
+  void writeString(std::string const & s)
+  {
+    put('"');
+    char const * pending = s.data();
+    char const * const end = s.data() + s.size();
+    for (char const * c = pending; c != end; ++c) {
+      auto const u = static_cast<unsigned char>(*c);
+      if (u >= 0x20 and u != '"' and u != '\\')
+        continue;
+      write(pending, c - pending);
+      pending = c + 1;
+      switch (u) {
+      case '"': write("\\\"", 2); break;
+      case '\\': write("\\\\", 2); break;
+      case '\n': write("\\n", 2); break;
+      case '\t': write("\\t", 2); break;
+      case '\r': write("\\r", 2); break;
+      default: {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", u);
+        write(escaped, 6);
+      }
+      }
+    }
+    write(pending, end - pending);
+    put('"');
+  }
+
+  /// Size of the blocks passed to the stream
+  static constexpr std::size_t blockSize = 1 << 16;
+
+  std::ostream & out;
+
+  std::string buffer;
+
+  /// For each open array or object, whether no element has been written yet
+  std::vector<bool> first;
+
+  /// Whether a key has been written, whose value comes next
+  bool afterKey = false;
+};
+
+}
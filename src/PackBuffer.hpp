@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace EventTimings {
+
+/// Appends trivially copyable values to a contiguous buffer of bytes.
+/** The bytes are copied as they are in memory, hence the buffer can only be read on the same architecture. */
+class PackBuffer
+{
+public:
+  template<typename T>
+  void pack(T const & value)
+  {
+    pack(&value, 1);
+  }
+
+  template<typename T>
+  void pack(T const * values, std::size_t n)
+  {
+    auto bytes = reinterpret_cast<char const *>(values);
+    data.insert(data.end(), bytes, bytes + n * sizeof(T));
+  }
+
+  /// Packs the number of elements followed by the elements
+  template<typename T>
+  void pack(std::vector<T> const & values)
+  {
+    pack(values.size());
+    pack(values.data(), values.size());
+  }
+
+  /// Packs the length followed by the characters
+  void pack(std::string const & s)
+  {
+    pack(s.size());
+    pack(s.data(), s.size());
+  }
+
+  std::vector<char> data;
+};
+
+
+/// Reads values in the order they were packed by a PackBuffer
+/** Reading beyond the end throws std::out_of_range, before anything is allocated for it. */
+class UnpackBuffer
+{
+public:
+  UnpackBuffer(char const * begin, char const * end)
+    : pos(begin), end(end)
+  {}
+
+  template<typename T>
+  void unpack(T & value)
+  {
+    unpack(&value, 1);
+  }
+
+  template<typename T>
+  void unpack(T * values, std::size_t n)
+  {
+    require(n, sizeof(T));
+    if (n > 0)
+      std::memcpy(values, pos, n * sizeof(T));
+    pos += n * sizeof(T);
+  }
+
+  template<typename T>
+  void unpack(std::vector<T> & values)
+  {
+    std::size_t n;
+    unpack(n);
+    require(n, sizeof(T));
+    values.resize(n);
+    unpack(values.data(), n);
+  }
+
+  void unpack(std::string & s)
+  {
+    std::size_t n;
+    unpack(n);
+    require(n, 1);
+    s.assign(pos, n);
+    pos += n;
+  }
+
+  /// Reads a value of type T
+  template<typename T>
+  T get()
+  {
+    T value;
+    unpack(value);
+    return value;
+  }
+
+  bool done() const
+  {
+    return pos >= end;
+  }
+
+  /// Returns the number of bytes left to read
+  std::size_t remaining() const
+  {
+    return done() ? 0 : end - pos;
+  }
+
+private:
+  /// Throws if less than n values of size bytes are left
+  void require(std::size_t n, std::size_t size) const
+  {
+    if (n > remaining() / size)
+      throw std::out_of_range("Unexpected end of the packed data");
+  }
+
+  char const * pos;
+  char const * end;
+};
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace EventTimings {
+
+/// Encodes the fields of a protobuf message into a string.
+/** A nested message is encoded by a ProtoWriter of its own and added by message, which prefixes its length.
+Clearing keeps the capacity, hence reused writers do not allocate. */
+class ProtoWriter
+{
+public:
+  /// Adds a field of type uint32, uint64, int32 or int64 of a non-negative value, bool or enum
+  void varint(std::uint32_t field, std::uint64_t value)
+  {
+    key(field, 0);
+    writeVarint(value);
+  }
+
+  /// Adds a field of type string or bytes
+  void bytes(std::uint32_t field, char const * data, std::size_t size)
+  {
+    key(field, 2);
+    writeVarint(size);
+    buffer.append(data, size);
+  }
+
+  void string(std::uint32_t field, std::string const & value)
+  {
+    bytes(field, value.data(), value.size());
+  }
+
+  /// Adds a field of a message type
+  void message(std::uint32_t field, ProtoWriter const & value)
+  {
+    bytes(field, value.buffer.data(), value.buffer.size());
+  }
+
+  /// Returns the encoded fields
+  std::string const & data() const
+  {
+    return buffer;
+  }
+
+  void clear()
+  {
+    buffer.clear();
+  }
+
+private:
+  /// Adds the key of a field, wire type 0 is a varint, 2 is length-delimited
+  void key(std::uint32_t field, std::uint32_t wireType)
+  {
+    writeVarint(field << 3 | wireType);
+  }
+
+  /// Adds 7 bits per byte starting with the lowest, the highest bit marks that more bytes follow
+  void writeVarint(std::uint64_t value)
+  {
+    while (value >= 0x80) {
+      buffer.push_back(static_cast<char>(value | 0x80));
+      value >>= 7;
+    }
+    buffer.push_back(static_cast<char>(value));
+  }
+
+  std::string buffer;
+};
+
+}
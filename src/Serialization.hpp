@@ -0,0 +1,108 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "EventTimings/EventUtils.hpp"
+#include "JSONWriter.hpp"
+#include "PackBuffer.hpp"
+
+namespace EventTimings {
+
+/// Identifies the binary file of Gather::SHARED_FILE
+constexpr char sharedFileMagic[8] = {'E', 'V', 'T', 'I', 'M', 'I', 'N', 'G'};
+
+/// Version of the layout of the binary file of Gather::SHARED_FILE
+constexpr std::uint32_t sharedFileVersion = 3;
+
+/// Bytes of a packed state change: the timestamp as int64, the id, thread and state as int32, without padding
+constexpr std::size_t stateChangeSize = sizeof(std::int64_t) + 3 * sizeof(std::int32_t);
+
+/// Index of the names of all ranks, agreed on collectively, events are sent with the index of their name
+struct NameTable
+{
+  /// Sorted hashes of the names of all ranks, the position of a hash is the index of its name
+  std::vector<std::uint64_t> hashes;
+
+  /// Names in the order of hashes, only known at rank 0
+  std::vector<std::string> names;
+
+  /// Returns the index of a name of this rank
+  std::uint32_t indexOf(std::string const & name) const;
+};
+
+/// Converts the time_point into a string like "2019-01-10T18:30:46.834"
+std::string timepoint_to_string(std::chrono::system_clock::time_point c);
+
+/// Writes a rank as an object of the Ranks of docs/Events.schema.json
+/**
+ * @param[in] names Names of the events of rank, indexed by EventID, e.g., EventRegistry::getEventNames
+ * @param[in] writeSpilled If given, writes state changes by writeStateChangeJSON before those of rank
+ */
+void writeRankJSON(JSONWriter & json, RankData const & rank, std::vector<std::string> const & names,
+                   std::function<void()> const & writeSpilled = nullptr);
+
+/// Writes a state change as an object, its id indexes names
+void writeStateChangeJSON(JSONWriter & json, Event::StateChange const & sc, std::vector<std::string> const & names);
+
+/// Writes the state changes of a rank as elements of the traceEvents of the Trace Event Format
+/**
+ * A start and the following stop or pause of the same event on the same thread are written as a complete
+ * event, starts without one as begin events. Stops without a start, i.e., after a pause, are skipped.
+ * Each thread is preceded by events naming it.
+ *
+ * @param[in] names Names of the events of rank, indexed by EventID
+ * @param[in] pid The process of the events, i.e., the participant
+ * @param[in] rankIndex The index of rank, the tid of its threads is getTraceTID(rankIndex, thread)
+ */
+void writeTraceEvents(JSONWriter & json, RankData const & rank, std::vector<std::string> const & names,
+                      int pid, int rankIndex);
+
+/// Writes the track of the process pid, which identifies the participant, as a packet of a Perfetto trace
+void writePerfettoProcess(std::ostream & out, int pid, std::string const & name);
+
+/// Writes the state changes of a rank as TracePacket protobuf messages of a Perfetto trace
+/**
+ * Each thread is a track of the process pid and a sequence of packets of its own. A sequence interns the
+ * event names and encodes each timestamp as the difference to the previous packet. A start begins a slice,
+ * a stop or pause ends it. Stops without a started slice, i.e., after a pause, are skipped.
+ *
+ * @param[in] names Names of the events of rank, indexed by EventID
+ * @param[in] rankIndex The index of rank, the tid of its threads is getTraceTID(rankIndex, thread)
+ * @param[in,out] sequenceCount Number of sequences written to out, numbers the sequences of the threads of rank
+ */
+void writePerfettoPackets(std::ostream & out, RankData const & rank, std::vector<std::string> const & names,
+                          int pid, int rankIndex, std::uint64_t & sequenceCount);
+
+/// Packs the columns of a DataStore
+void pack(PackBuffer & buffer, DataStore const & data);
+
+/// Unpacks the columns of a DataStore
+DataStore unpackDataStore(UnpackBuffer & buffer);
+
+/// Packs the aggregated data of an event, identified by its index in the name table
+void pack(PackBuffer & buffer, std::uint32_t id, EventData const & ev);
+
+/// Unpacks the aggregated data of an event and its index, names is the name table, if known
+std::pair<std::uint32_t, EventData> unpackEventData(UnpackBuffer & buffer, std::vector<std::string> const & names);
+
+/// Packs a state change as fixed-width fields of stateChangeSize bytes in total
+void pack(PackBuffer & buffer, Event::StateChange const & sc);
+
+/// Unpacks a state change packed by pack
+Event::StateChange unpackStateChange(UnpackBuffer & buffer);
+
+/// Unpacks the data of a rank packed by EventRegistry::packRankData
+/**
+ * @param[in] names The name table the events are identified by
+ * @param[in] localIDs The EventID in localNames of each entry of names
+ * @param[in] localNames The name table of the returned RankData, e.g., EventRegistry::getEventNames
+ */
+RankData unpackRankData(UnpackBuffer & buffer, std::vector<std::string> const & names,
+                        std::vector<EventID> const & localIDs, std::vector<std::string> const & localNames);
+
+}
@@ -0,0 +1,552 @@
+#include "TraceConverter.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include "JSONWriter.hpp"
+#include "json.hpp"
+
+namespace EventTimings {
+
+namespace {
+
+/// Bytes of output a thread collects before appending them
+constexpr std::size_t blockSize = 1 << 20;
+
+/// A log file to convert
+struct Task
+{
+  /// Process of the participant
+  int pid;
+
+  std::string filename;
+
+  /// Index of the first rank of the file
+  long firstRank;
+
+  /// Nanoseconds added to the timestamps of the file
+  long long shift;
+};
+
+/// SAX handler that accepts everything, handlers hide the methods they need
+struct IgnoreAll
+{
+  bool null() { return true; }
+  bool boolean(bool) { return true; }
+  bool number_integer(std::int64_t) { return true; }
+  bool number_unsigned(std::uint64_t) { return true; }
+  bool number_float(double, std::string const &) { return true; }
+  bool string(std::string &) { return true; }
+  bool start_object(std::size_t) { return true; }
+  bool key(std::string &) { return true; }
+  bool end_object() { return true; }
+  bool start_array(std::size_t) { return true; }
+  bool end_array() { return true; }
+
+  bool parse_error(std::size_t, std::string const &, nlohmann::detail::exception const & e)
+  {
+    throw std::runtime_error(e.what());
+  }
+};
+
+/// Parses a file with a SAX handler, which may stop early
+template<typename Handler>
+void parse(std::string const & filename, Handler & handler)
+{
+  std::vector<char> buffer(blockSize);
+  std::ifstream in;
+  in.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+  in.open(filename, std::ios::binary);
+  if (not in)
+    throw std::runtime_error("Could not open " + filename);
+  try {
+    nlohmann::json::sax_parse(in, &handler);
+  }
+  catch (std::exception const & e) {
+    throw std::runtime_error("Could not parse " + filename + ": " + e.what());
+  }
+}
+
+/// Reads the initialized time of a log file and the files of an index, stops at the ranks
+struct Header : IgnoreAll
+{
+  std::string initialized;
+
+  /// Files of an index, empty for a log file
+  std::vector<std::string> files;
+
+  int depth = 0;
+
+  /// Last key at depth 1
+  std::string member;
+
+  bool start_object(std::size_t)
+  {
+    ++depth;
+    return true;
+  }
+
+  bool end_object()
+  {
+    --depth;
+    return true;
+  }
+
+  bool start_array(std::size_t)
+  {
+    ++depth;
+    return true;
+  }
+
+  bool end_array()
+  {
+    --depth;
+    return true;
+  }
+
+  bool key(std::string & k)
+  {
+    if (depth != 1)
+      return true;
+    member = k;
+    return not (member == "Ranks" and not initialized.empty());
+  }
+
+  bool string(std::string & value)
+  {
+    if (depth == 1 and member == "Initialized")
+      initialized = value;
+    else if (depth == 2 and member == "Files")
+      files.push_back(value);
+    return true;
+  }
+};
+
+/// Collects the events of several threads into a single JSON array
+class TraceOutput
+{
+public:
+  explicit TraceOutput(std::ostream & out)
+    : out(out)
+  {}
+
+  /// Appends a block of events separated by commas, whose first character is replaced by a separator
+  void append(std::string const & block)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    out.put(empty ? '[' : ',');
+    out.write(block.data() + 1, block.size() - 1);
+    empty = false;
+  }
+
+  void close()
+  {
+    if (empty)
+      out.put('[');
+    out << ']' << std::endl;
+  }
+
+private:
+  std::ostream & out;
+
+  std::mutex mutex;
+
+  /// Whether no block has been appended yet
+  bool empty = true;
+};
+
+/// Writes events of one thread into blocks, which are appended to the output when full
+class TraceBlocks
+{
+public:
+  explicit TraceBlocks(TraceOutput & output)
+    : output(output),
+      json(block)
+  {
+    // The writer separates all events, the bracket is replaced when appending the first block
+    json.beginArray();
+  }
+
+  /// Writer of the current block, call next after each event
+  JSONWriter & writer()
+  {
+    return json;
+  }
+
+  /// Appends the block if it is full
+  void next()
+  {
+    if (static_cast<std::size_t>(block.tellp()) >= blockSize)
+      flush();
+  }
+
+  /// Appends the block if it contains any events
+  void flush()
+  {
+    json.flush();
+    auto const s = block.str();
+    if (s.size() > 1) {
+      output.append(s);
+      block.str("");
+    }
+  }
+
+private:
+  TraceOutput & output;
+
+  std::ostringstream block;
+
+  JSONWriter json;
+};
+
+/// Writes a metadata event, which sets the argument key to value
+template<typename T>
+void writeMetadata(TraceBlocks & blocks, char const * name, int pid, long tid, char const * key, T const & value)
+{
+  auto & json = blocks.writer();
+  json.beginObject();
+  json.key("name").value(name);
+  json.key("ph").value("M");
+  json.key("pid").value(pid);
+  json.key("tid").value(tid);
+  json.key("args").beginObject().key(key).value(value).endObject();
+  json.endObject();
+  blocks.next();
+}
+
+/// Converts the state changes of a log file to trace events while it is parsed
+/** The state changes are at Ranks[i].StateChanges[j], i.e., at depth 5 counting the outermost object as 1. */
+class Converter : public IgnoreAll
+{
+public:
+  Converter(ConversionOptions const & options, TraceBlocks & blocks, Task const & task)
+    : options(options),
+      blocks(blocks),
+      task(task),
+      rank(task.firstRank - 1)
+  {}
+
+  bool start_object(std::size_t)
+  {
+    ++depth;
+    if (depth == 3 and inRanks)
+      beginRank();
+    else if (depth == 5 and inStateChanges)
+      sc = StateChange();
+    return true;
+  }
+
+  bool end_object()
+  {
+    if (depth == 5 and inStateChanges)
+      convert();
+    else if (depth == 3 and inRanks)
+      endRank();
+    --depth;
+    return true;
+  }
+
+  bool start_array(std::size_t)
+  {
+    ++depth;
+    if (depth == 2 and member == "Ranks")
+      inRanks = true;
+    else if (depth == 4 and inRanks and rankMember == "StateChanges")
+      inStateChanges = true;
+    return true;
+  }
+
+  bool end_array()
+  {
+    if (depth == 4)
+      inStateChanges = false;
+    else if (depth == 2)
+      inRanks = false;
+    --depth;
+    return true;
+  }
+
+  bool key(std::string & k)
+  {
+    if (depth == 1)
+      member = k;
+    else if (depth == 3)
+      rankMember = k;
+    else if (depth == 5)
+      field = k;
+    return true;
+  }
+
+  bool number_integer(std::int64_t value)
+  {
+    setField(value);
+    return true;
+  }
+
+  bool number_unsigned(std::uint64_t value)
+  {
+    setField(value);
+    return true;
+  }
+
+  bool number_float(double value, std::string const &)
+  {
+    setField(static_cast<long long>(value));
+    return true;
+  }
+
+  bool string(std::string & value)
+  {
+    if (depth == 5 and inStateChanges and field == "Name")
+      sc.name = std::move(value);
+    return true;
+  }
+
+private:
+  struct StateChange
+  {
+    std::string name;
+    int state = 0;
+    long long timestamp = 0;
+    long thread = 0;
+  };
+
+  /// A name and its category, the interned names of a file are indexed by their position
+  struct Name
+  {
+    std::string name;
+    std::string const * category;
+  };
+
+  void setField(long long value)
+  {
+    if (depth != 5 or not inStateChanges)
+      return;
+    if (field == "State")
+      sc.state = value;
+    else if (field == "Timestamp")
+      sc.timestamp = value;
+    else if (field == "Thread")
+      sc.thread = value;
+  }
+
+  void beginRank()
+  {
+    ++rank;
+    skipRank = not options.ranks.empty() and options.ranks.count(rank) == 0;
+    threads.clear();
+    if (not skipRank)
+      addThread(0);
+  }
+
+  /// Names a thread of the rank
+  void addThread(long thread)
+  {
+    if (not threads.insert(thread).second)
+      return;
+    std::string name = "Rank " + std::to_string(rank);
+    if (thread > 0)
+      name += " thread " + std::to_string(thread);
+    long const tid = getTraceTID(rank, thread);
+    writeMetadata(blocks, "thread_name", task.pid, tid, "name", name);
+    writeMetadata(blocks, "thread_sort_index", task.pid, tid, "sort_index", getTraceSortIndex(rank, thread));
+  }
+
+  /// Returns the index of an interned name
+  std::size_t intern(std::string const & name)
+  {
+    auto const it = ids.find(name);
+    if (it != ids.end())
+      return it->second;
+    auto const category = options.mapping.find(name);
+    names.push_back({name, category == options.mapping.end() ? &options.defaultCategory : &category->second});
+    ids.emplace(name, names.size() - 1);
+    return names.size() - 1;
+  }
+
+  void convert()
+  {
+    if (skipRank or (options.noGlobal and sc.name == "_GLOBAL"))
+      return;
+    long long const timestamp = sc.timestamp + task.shift;
+    if (options.maxTime >= 0 and timestamp > options.maxTime)
+      return;
+
+    addThread(sc.thread);
+    auto const id = intern(sc.name);
+    long const tid = getTraceTID(rank, sc.thread);
+    // A stop without a start follows a pause, which already ended the event
+    auto & starts = running[static_cast<std::uint64_t>(sc.thread) << 32 | id];
+    if (sc.state == 1)
+      starts.push_back(timestamp);
+    else if (not starts.empty()) {
+      writeEvent("X", id, tid, starts.back(), timestamp - starts.back());
+      starts.pop_back();
+    }
+  }
+
+  /// Writes events of the rank that were not stopped
+  void endRank()
+  {
+    for (auto const & r : running) {
+      long const tid = getTraceTID(rank, static_cast<long>(r.first >> 32));
+      for (auto const start : r.second)
+        writeEvent("B", r.first & 0xffffffff, tid, start);
+    }
+    running.clear();
+  }
+
+  /// Writes an event with timestamp and the duration of a complete event in microseconds
+  void writeEvent(char const * phase, std::size_t id, long tid, long long timestamp, long long duration = 0)
+  {
+    auto & json = blocks.writer();
+    json.beginObject();
+    json.key("name").value(names[id].name);
+    json.key("cat").value(*names[id].category);
+    json.key("ph").value(phase);
+    json.key("pid").value(task.pid);
+    json.key("tid").value(tid);
+    json.key("ts").value(timestamp / 1e3);
+    if (phase[0] == 'X')
+      json.key("dur").value(duration / 1e3);
+    json.endObject();
+    blocks.next();
+  }
+
+  ConversionOptions const & options;
+
+  TraceBlocks & blocks;
+
+  Task const & task;
+
+  int depth = 0;
+
+  /// Last keys at the depths of the log, its ranks and their state changes
+  std::string member, rankMember, field;
+
+  bool inRanks = false, inStateChanges = false;
+
+  /// Index of the current rank
+  long rank;
+
+  /// Whether the current rank is filtered out
+  bool skipRank = false;
+
+  /// Threads of the current rank that have been named
+  std::set<long> threads;
+
+  /// The state change being parsed
+  StateChange sc;
+
+  std::unordered_map<std::string, std::size_t> ids;
+
+  std::vector<Name> names;
+
+  /// Starts of the running events of the current rank by thread and interned name
+  std::unordered_map<std::uint64_t, std::vector<long long>> running;
+};
+
+}
+
+long long parseTime(std::string const & time)
+{
+  int y, m, d, hh, mm, ss;
+  char fraction[16] = "";
+  if (std::sscanf(time.c_str(), "%d-%d-%dT%d:%d:%d.%15[0-9]", &y, &m, &d, &hh, &mm, &ss, fraction) < 6)
+    throw std::runtime_error("Invalid time " + time);
+
+  // Days since 1970-01-01 in the proleptic Gregorian calendar
+  y -= m <= 2;
+  long long const era = (y >= 0 ? y : y - 399) / 400;
+  long long const yearOfEra = y - era * 400;
+  long long const dayOfYear = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  long long const dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  long long const days = era * 146097 + dayOfEra - 719468;
+
+  long long ns = (((days * 24 + hh) * 60 + mm) * 60 + ss) * 1000000000ll;
+  long long scale = 100000000;
+  for (char const * c = fraction; *c and scale > 0; ++c, scale /= 10)
+    ns += (*c - '0') * scale;
+  return ns;
+}
+
+void convertToTrace(ConversionOptions const & options, std::ostream & out)
+{
+  // Only the beginning of a log file is parsed for its initialized time, index files are small
+  std::vector<Task> tasks;
+  std::vector<long long> initialized;
+  for (std::size_t pid = 0; pid < options.logs.size(); ++pid) {
+    auto const & filename = options.logs[pid].second;
+    Header header;
+    parse(filename, header);
+    if (header.initialized.empty())
+      throw std::runtime_error("No initialized time in " + filename);
+    initialized.push_back(parseTime(header.initialized));
+
+    if (header.files.empty()) {
+      tasks.push_back({static_cast<int>(pid), filename, 0, 0});
+      continue;
+    }
+    auto const slash = filename.rfind('/');
+    std::string const directory = slash == std::string::npos ? "" : filename.substr(0, slash + 1);
+    for (std::size_t rank = 0; rank < header.files.size(); ++rank) {
+      auto const & file = header.files[rank];
+      tasks.push_back({static_cast<int>(pid), file.front() == '/' ? file : directory + file,
+                       static_cast<long>(rank), 0});
+    }
+  }
+  if (options.normalize and not initialized.empty()) {
+    auto const first = *std::min_element(initialized.begin(), initialized.end());
+    for (auto & task : tasks)
+      task.shift = initialized[task.pid] - first;
+  }
+
+  TraceOutput output(out);
+  {
+    TraceBlocks blocks(output);
+    for (std::size_t pid = 0; pid < options.logs.size(); ++pid)
+      writeMetadata(blocks, "process_name", static_cast<int>(pid), 0, "name", options.logs[pid].first);
+    blocks.flush();
+  }
+
+  // Each thread converts one file at a time, the first error is reported
+  std::atomic<std::size_t> next{0};
+  std::exception_ptr error;
+  std::mutex errorMutex;
+  auto work = [&] {
+    try {
+      TraceBlocks blocks(output);
+      for (std::size_t i = next++; i < tasks.size(); i = next++) {
+        Converter converter(options, blocks, tasks[i]);
+        parse(tasks[i].filename, converter);
+      }
+      blocks.flush();
+    }
+    catch (...) {
+      std::lock_guard<std::mutex> lock(errorMutex);
+      if (not error)
+        error = std::current_exception();
+      next = tasks.size();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < std::min<std::size_t>(options.threads, tasks.size()); ++t)
+    threads.emplace_back(work);
+  work();
+  for (auto & t : threads)
+    t.join();
+  if (error)
+    std::rethrow_exception(error);
+
+  output.close();
+}
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace EventTimings {
+
+/// What convertToTrace converts, the options of events2trace
+struct ConversionOptions
+{
+  /// Name and log file of each participant, in the order of their pids.
+  /** A log file is the JSON output of writeJSON or the index of Gather::FILES, whose files are relative to it. */
+  std::vector<std::pair<std::string, std::string>> logs;
+
+  /// Category of events without an entry in mapping
+  std::string defaultCategory = "default";
+
+  /// Category of events by name
+  std::map<std::string, std::string> mapping;
+
+  /// Whether to skip the global event
+  bool noGlobal = false;
+
+  /// Ranks to convert, all if empty
+  std::set<long> ranks;
+
+  /// Maximum timestamp in nanoseconds to convert, after normalization, no maximum if negative
+  long long maxTime = -1;
+
+  /// Whether to shift the timestamps of each participant to the first initialized participant
+  bool normalize = true;
+
+  /// Number of threads converting files
+  unsigned threads = 1;
+};
+
+/// Converts the state changes of the log files of all participants into a single trace in the Trace Event Format
+/** Each participant is a process, each thread of a rank a thread with the rank as tid of the first thread.
+ *  A start and the following stop or pause of an event form a complete event, a stop after a pause is skipped.
+ *  The files are parsed by a streaming parser on several threads, which hold only the running events and a block
+ *  of the output each. Hence, the memory does not depend on the size of the files. Blocks of different files are
+ *  interleaved. */
+void convertToTrace(ConversionOptions const & options, std::ostream & out);
+
+/// The tid of thread t of a rank is rank + t * traceThreadStride, so the first thread keeps the rank as tid.
+/** Used by convertToTrace and EventRegistry::writeTrace, hence traces of the same run agree on their tids. */
+constexpr long traceThreadStride = 1 << 20;
+
+/// Returns the tid of a thread of a rank in the Trace Event Format and Perfetto traces
+constexpr long getTraceTID(long rank, long thread)
+{
+  return rank + thread * traceThreadStride;
+}
+
+/// Returns the sort index of the track of a thread, the threads of a rank are sorted after the rank
+constexpr long getTraceSortIndex(long rank, long thread)
+{
+  return rank * traceThreadStride + thread;
+}
+
+/// Parses a time like "2019-01-10T18:30:46.834" of the JSON output into nanoseconds since 1970-01-01T00:00
+long long parseTime(std::string const & time);
+
+}
@@ -0,0 +1,231 @@
+#include "EventTimings/TraceFile.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "PackBuffer.hpp"
+#include "Serialization.hpp"
+
+namespace EventTimings {
+
+using sys_clk = std::chrono::system_clock;
+
+static_assert(TraceFile::StateChanges::recordSize == stateChangeSize, "Record size differs from the packed size");
+
+constexpr std::size_t TraceFile::StateChanges::recordSize;
+
+namespace {
+
+/// Throws if less than n bytes are left in buffer
+void require(UnpackBuffer const & buffer, std::size_t n, std::string const & filename)
+{
+  if (buffer.remaining() < n)
+    throw std::runtime_error("Unexpected end of the trace file " + filename);
+}
+
+/// Reads a length and as many characters, checking the length against the remaining bytes
+std::string readString(UnpackBuffer & buffer, std::string const & filename)
+{
+  require(buffer, sizeof(std::size_t), filename);
+  auto const length = buffer.get<std::size_t>();
+  require(buffer, length, filename);
+  std::string s(length, '\0');
+  buffer.unpack(&s[0], length);
+  return s;
+}
+
+}
+
+Event::StateChange TraceFile::StateChanges::iterator::operator*() const
+{
+  UnpackBuffer buffer(pos, pos + recordSize);
+  return unpackStateChange(buffer);
+}
+
+TraceFile::TraceFile(std::string const & filename)
+  : filename(filename)
+{
+  int const fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Could not open the trace file " + filename);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw std::runtime_error("Could not read the size of the trace file " + filename);
+  }
+  size = st.st_size;
+  if (size > 0) {
+    void * mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+      throw std::runtime_error("Could not map the trace file " + filename);
+    data = static_cast<char const *>(mapping);
+  }
+  else {
+    close(fd);
+  }
+
+  // Segments follow each other, each ends with the section of its last rank
+  std::uint64_t offset = 0;
+  // The indices of the names in names, which joins the name tables of all segments
+  std::unordered_map<std::string, EventID> ids;
+  try {
+    while (offset < size) {
+      UnpackBuffer buffer(data + offset, data + size);
+      char magic[sizeof(sharedFileMagic)];
+      require(buffer, sizeof(magic) + sizeof(std::uint32_t) + sizeof(std::uint64_t), filename);
+      buffer.unpack(magic, sizeof(magic));
+      if (not std::equal(magic, magic + sizeof(magic), sharedFileMagic))
+        throw std::runtime_error(filename + " is not a trace file");
+      if (buffer.get<std::uint32_t>() != sharedFileVersion)
+        throw std::runtime_error("Unsupported version of the trace file " + filename);
+      auto const ranks = buffer.get<std::uint64_t>();
+      if (ranks == 0)
+        throw std::runtime_error("No ranks in the trace file " + filename);
+      if (not segments.empty() and ranks != segments.front().sections.size())
+        throw std::runtime_error("Segments of the trace file " + filename + " differ in their number of ranks");
+
+      Segment segment;
+      segment.runName = readString(buffer, filename);
+      // Each name takes at least the bytes of its length, which bounds their number before allocating
+      require(buffer, sizeof(std::size_t), filename);
+      auto const names = buffer.get<std::size_t>();
+      if (names > buffer.remaining() / sizeof(std::size_t))
+        throw std::runtime_error("Unexpected end of the trace file " + filename);
+      segment.names.reserve(names);
+      std::vector<EventID> segmentIDs;
+      for (std::size_t i = 0; i < names; ++i) {
+        segment.names.push_back(readString(buffer, filename));
+        auto const insertion = ids.emplace(segment.names.back(), this->names.size());
+        if (insertion.second)
+          this->names.push_back(segment.names.back());
+        segmentIDs.push_back(insertion.first->second);
+      }
+      localIDs.push_back(std::move(segmentIDs));
+
+      // The offset table of the sections, their state changes are at the end of each
+      if (ranks > buffer.remaining() / (3 * sizeof(std::uint64_t)))
+        throw std::runtime_error("Unexpected end of the trace file " + filename);
+      for (std::uint64_t r = 0; r < ranks; ++r) {
+        std::uint64_t entry[3];
+        buffer.unpack(entry, 3);
+        // Compared without overflow, the entries may be anything in a corrupt file
+        if (entry[0] > size or entry[1] > size - entry[0] or entry[2] > entry[1] / stateChangeSize
+            or entry[1] < 2 * sizeof(sys_clk::rep) + entry[2] * stateChangeSize)
+          throw std::runtime_error("Invalid section of rank " + std::to_string(r) + " in the trace file " + filename);
+
+        auto const stateChangesSize = entry[2] * stateChangeSize;
+        char const * begin = data + entry[0];
+        char const * end = begin + entry[1];
+        UnpackBuffer section(begin, end);
+        auto const initializedAt = sys_clk::time_point(sys_clk::duration(section.get<sys_clk::rep>()));
+        auto const finalizedAt = sys_clk::time_point(sys_clk::duration(section.get<sys_clk::rep>()));
+        segment.sections.push_back({initializedAt, finalizedAt, StateChanges(end - stateChangesSize, entry[2]),
+                                    begin, end});
+        offset = entry[0] + entry[1];
+      }
+      segments.push_back(std::move(segment));
+    }
+  }
+  catch (...) {
+    if (data)
+      munmap(const_cast<char *>(data), size);
+    throw;
+  }
+}
+
+TraceFile::~TraceFile()
+{
+  if (data)
+    munmap(const_cast<char *>(data), size);
+}
+
+std::vector<TraceFile::Segment> const & TraceFile::getSegments() const
+{
+  return segments;
+}
+
+std::vector<std::string> const & TraceFile::getNames() const
+{
+  return names;
+}
+
+int TraceFile::getRanks() const
+{
+  return segments.empty() ? 0 : segments.front().sections.size();
+}
+
+RankData TraceFile::load(int rank) const
+{
+  RankData data;
+  for (std::size_t i = 0; i < segments.size(); ++i) {
+    auto const & segment = segments[i];
+    auto const & section = segment.sections.at(rank);
+    auto const & ids = localIDs[i];
+
+    if (i == 0)
+      data.initializedAt = section.initializedAt;
+
+    std::string const invalid = "Invalid section of rank " + std::to_string(rank) + " in the trace file " + filename;
+
+    // The state changes of earlier segments are read directly, the last one is unpacked completely
+    if (i + 1 < segments.size()) {
+      for (auto sc : section.stateChanges) {
+        if (sc.id < 0 or static_cast<std::size_t>(sc.id) >= ids.size())
+          throw std::runtime_error(invalid);
+        sc.id = ids[sc.id];
+        data.stateChanges.push(sc);
+      }
+      continue;
+    }
+
+    // Lengths and indices are checked while unpacking
+    UnpackBuffer buffer(section.begin, section.end);
+    RankData last;
+    try {
+      last = unpackRankData(buffer, segment.names, ids, names);
+    }
+    catch (std::out_of_range const &) {
+      throw std::runtime_error(invalid);
+    }
+    data.evData = std::move(last.evData);
+    data.stateChanges.append(std::move(last.stateChanges));
+    data.finalizedAt = last.finalizedAt;
+  }
+  return data;
+}
+
+void TraceFile::writeJSON(std::ostream & out) const
+{
+  JSONWriter json(out);
+  json.beginObject();
+  if (not segments.empty()) {
+    auto const & sections = segments.back().sections;
+    auto const initT = std::min_element(segments.front().sections.begin(), segments.front().sections.end(),
+                                        [](Section const & a, Section const & b) {
+                                          return a.initializedAt < b.initializedAt;
+                                        })->initializedAt;
+    auto const finalT = std::max_element(sections.begin(), sections.end(),
+                                         [](Section const & a, Section const & b) {
+                                           return a.finalizedAt < b.finalizedAt;
+                                         })->finalizedAt;
+    json.key("Finalized").value(timepoint_to_string(finalT));
+    json.key("Initialized").value(timepoint_to_string(initT));
+    json.key("Name").value(segments.back().runName);
+  }
+
+  // One rank at a time is unpacked
+  json.key("Ranks").beginArray();
+  for (int rank = 0; rank < getRanks(); ++rank)
+    writeRankJSON(json, load(rank), names);
+  json.endArray();
+  json.endObject();
+  out << std::endl;
+}
+
+}
@@ -0,0 +1,123 @@
+#include "TraceSpill.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+namespace EventTimings {
+
+TraceSpill::TraceSpill(std::string filename, std::size_t budget)
+  : filename(std::move(filename)),
+    budget(std::max<std::size_t>(1, budget / sizeof(Chunk))),
+    file(this->filename, std::ios::binary | std::ios::trunc)
+{
+  if (not file)
+    throw std::runtime_error("Could not open trace spill file " + this->filename);
+
+  writer = std::thread(&TraceSpill::write, this);
+}
+
+TraceSpill::~TraceSpill()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  changed.notify_all();
+  writer.join();
+  file.close();
+  std::remove(filename.c_str());
+}
+
+std::unique_ptr<TraceSpill::Chunk> TraceSpill::exchange(std::vector<std::unique_ptr<Chunk>> & full)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  if (allocated < budget) {
+    ++allocated;
+    lock.unlock();
+    return std::unique_ptr<Chunk>(new Chunk);
+  }
+
+  for (auto & chunk : full)
+    queue.push_back(std::move(chunk));
+  full.clear();
+  changed.notify_all();
+
+  // Without pending chunks, none will become free. This happens when other timelines hold the budget.
+  changed.wait(lock, [this] { return not freeChunks.empty() or (queue.empty() and not writing); });
+  if (freeChunks.empty()) {
+    ++allocated;
+    lock.unlock();
+    return std::unique_ptr<Chunk>(new Chunk);
+  }
+
+  auto chunk = std::move(freeChunks.back());
+  freeChunks.pop_back();
+  return chunk;
+}
+
+void TraceSpill::flush()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  changed.wait(lock, [this] { return queue.empty() and not writing; });
+  file.flush();
+}
+
+void TraceSpill::clear()
+{
+  flush();
+  std::lock_guard<std::mutex> lock(mutex);
+  file.close();
+  file.open(filename, std::ios::binary | std::ios::trunc);
+  written = 0;
+}
+
+void TraceSpill::release(std::size_t chunks)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  // Chunks allocated before the spill was attached were not counted
+  allocated -= std::min(chunks, allocated);
+}
+
+std::size_t TraceSpill::size() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return written;
+}
+
+void TraceSpill::read(std::function<void(Event::StateChange const &)> const & f)
+{
+  std::ifstream in(filename, std::ios::binary);
+  std::unique_ptr<Chunk> chunk(new Chunk);
+  auto const chunkBytes = sizeof(chunk->records);
+  while (in.read(reinterpret_cast<char *>(chunk->records), chunkBytes) or in.gcount() > 0) {
+    std::size_t const n = in.gcount() / sizeof(Event::StateChange);
+    for (std::size_t i = 0; i < n; ++i)
+      f(chunk->records[i]);
+  }
+}
+
+void TraceSpill::write()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    changed.wait(lock, [this] { return stopping or not queue.empty(); });
+    if (queue.empty())
+      return;
+
+    auto chunk = std::move(queue.front());
+    queue.pop_front();
+    writing = true;
+    lock.unlock();
+
+    file.write(reinterpret_cast<char const *>(chunk->records), chunk->size * sizeof(Event::StateChange));
+
+    lock.lock();
+    written += chunk->size;
+    chunk->size = 0;
+    freeChunks.push_back(std::move(chunk));
+    writing = false;
+    changed.notify_all();
+  }
+}
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "EventTimings/EventUtils.hpp"
+
+namespace EventTimings {
+
+/// Bounds the memory of the state changes of a rank by writing full chunks to a file.
+/** Timelines of all threads allocate their chunks from the budget. When it is exhausted, a timeline hands
+its full chunks to a background thread, which writes them to the file and returns them for reuse.
+The state changes of a thread keep their order in the file. */
+class TraceSpill
+{
+public:
+  using Chunk = Timeline::Chunk;
+
+  /// Creates the file and starts the background thread
+  /**
+   * @param[in] filename File the state changes are written to, it is removed on destruction
+   * @param[in] budget Maximum number of bytes of the chunks held in memory by all timelines together,
+   *                   at least one chunk is allowed
+   */
+  TraceSpill(std::string filename, std::size_t budget);
+
+  TraceSpill(const TraceSpill & other) = delete;
+
+  /// Stops the background thread and removes the file
+  ~TraceSpill();
+
+  /// Returns an empty chunk for a timeline whose last chunk is full
+  /** If the budget is exhausted, all chunks of the timeline are handed over to be written
+   *  and the call blocks until a written chunk can be reused. */
+  std::unique_ptr<Chunk> exchange(std::vector<std::unique_ptr<Chunk>> & full);
+
+  /// Waits until all handed over chunks are written
+  void flush();
+
+  /// Removes all written state changes
+  void clear();
+
+  /// Returns chunks that were freed by a timeline to the budget
+  void release(std::size_t chunks);
+
+  /// Returns the number of written state changes, call flush before
+  std::size_t size() const;
+
+  /// Reads all written state changes back, one chunk at a time, call flush before
+  void read(std::function<void(Event::StateChange const &)> const & f);
+
+private:
+  /// Loop of the background thread
+  void write();
+
+  std::string filename;
+
+  /// Maximum number of chunks held in memory
+  std::size_t const budget;
+
+  /// Number of chunks allocated from the budget
+  std::size_t allocated = 0;
+
+  /// Full chunks, waiting to be written
+  std::deque<std::unique_ptr<Chunk>> queue;
+
+  /// Written chunks, ready for reuse
+  std::vector<std::unique_ptr<Chunk>> freeChunks;
+
+  /// Whether the background thread is currently writing a chunk
+  bool writing = false;
+
+  bool stopping = false;
+
+  std::size_t written = 0;
+
+  std::ofstream file;
+
+  /// Guards all members above
+  mutable std::mutex mutex;
+  std::condition_variable changed;
+
+  std::thread writer;
+};
+
+}
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mpi.h>
+#include "EventTimings/EventUtils.hpp"
+#include "TableWriter.hpp"
+
+using namespace EventTimings;
+
+/// Header of an event in the per-event collection that finalize used before the packed MPI_Gatherv
+struct PerEventHeader
+{
+  char name[255] = {'\0'};
+  int id = 0, count = 0;
+  long total = 0, max = 0, min = 0;
+  /// Sizes of the histogram and the six data columns that follow the header
+  int sizes[7] = {};
+};
+
+/// Sends the data of events with instances each to rank 0 in the message pattern of the former collect.
+/** Per event a header, its histogram and six data columns, followed by the state changes of all events,
+ *  received rank by rank. The buffers have the sizes of the data recorded by main, their content is not
+ *  unpacked, which makes it a lower bound of the former collect. */
+void collectPerEvent(int events, int instances, MPI_Comm comm)
+{
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  // Each instance is started and stopped, a state change was sent as four longs
+  std::vector<long> stateChanges(events * instances * 2 * 4);
+  std::vector<int> eventsPerRank(size);
+  MPI_Gather(&events, 1, MPI_INT, eventsPerRank.data(), 1, MPI_INT, 0, comm);
+
+  // The histogram as pairs of bucket and count and the columns of the keys "iterations" and "residual"
+  std::vector<PerEventHeader> headers(events);
+  std::vector<long> histogram(2 * 2), instanceColumn(2 * instances);
+  std::vector<char> keys(sizeof("iterations") + sizeof("residual"));
+  std::vector<int> columns(2 * 3);
+  std::vector<std::int64_t> integers(instances);
+  std::vector<double> reals(instances), summaries(2 * 4);
+
+  std::vector<MPI_Request> requests;
+  auto const send = [&](void const * data, int count, MPI_Datatype type) {
+    requests.emplace_back();
+    MPI_Isend(data, count, type, 0, 0, comm, &requests.back());
+  };
+  long const times[3] = {0, 0, static_cast<long>(stateChanges.size() / 4)};
+  send(times, 3, MPI_LONG);
+  for (auto & header : headers) {
+    header.count = instances;
+    int const sizes[7] = {static_cast<int>(histogram.size()), static_cast<int>(keys.size()),
+                          static_cast<int>(columns.size()), instances, instances,
+                          static_cast<int>(instanceColumn.size()), static_cast<int>(summaries.size())};
+    std::copy(sizes, sizes + 7, header.sizes);
+    send(&header, sizeof(header), MPI_BYTE);
+    send(histogram.data(), histogram.size(), MPI_LONG);
+    send(keys.data(), keys.size(), MPI_CHAR);
+    send(columns.data(), columns.size(), MPI_INT);
+    send(integers.data(), integers.size(), MPI_INT64_T);
+    send(reals.data(), reals.size(), MPI_DOUBLE);
+    send(instanceColumn.data(), instanceColumn.size(), MPI_LONG);
+    send(summaries.data(), summaries.size(), MPI_DOUBLE);
+  }
+  send(stateChanges.data(), stateChanges.size(), MPI_LONG);
+
+  if (rank == 0) {
+    MPI_Datatype const types[7] = {MPI_LONG, MPI_CHAR, MPI_INT, MPI_INT64_T, MPI_DOUBLE, MPI_LONG, MPI_DOUBLE};
+    std::size_t const typeSizes[7] = {sizeof(long), sizeof(char), sizeof(int), sizeof(std::int64_t),
+                                      sizeof(double), sizeof(long), sizeof(double)};
+    for (int r = 0; r < size; ++r) {
+      long recvTimes[3];
+      MPI_Recv(recvTimes, 3, MPI_LONG, r, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
+      for (int e = 0; e < eventsPerRank[r]; ++e) {
+        PerEventHeader header;
+        MPI_Recv(&header, sizeof(header), MPI_BYTE, r, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
+        for (int c = 0; c < 7; ++c) {
+          std::vector<char> column(header.sizes[c] * typeSizes[c]);
+          MPI_Recv(column.data(), header.sizes[c], types[c], r, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
+        }
+      }
+      std::vector<long> recvStateChanges(recvTimes[2] * 4);
+      MPI_Recv(recvStateChanges.data(), recvStateChanges.size(), MPI_LONG, r, MPI_ANY_TAG, comm,
+               MPI_STATUS_IGNORE);
+    }
+  }
+  MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+}
+
+/// Returns the duration of f in milliseconds on the slowest rank at rank 0
+template<typename F>
+double measureSlowest(F f)
+{
+  MPI_Barrier(MPI_COMM_WORLD);
+  auto const start = std::chrono::steady_clock::now();
+  f();
+  auto const stop = std::chrono::steady_clock::now();
+
+  double const local = std::chrono::duration<double, std::milli>(stop - start).count();
+  double slowest;
+  MPI_Reduce(&local, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+  return slowest;
+}
+
+/// Measures the duration of finalize, i.e., of collecting the data of all ranks at rank 0.
+/** Compared to the messages of the former per-event collection of the same data.
+ *  Usage: mpirun -np N benchcollect [events] [instances] */
+int main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  int const events = argc > 1 ? std::atoi(argv[1]) : 200;
+  int const instances = argc > 2 ? std::atoi(argv[2]) : 10;
+  int const repetitions = 5;
+
+  std::vector<EventID> ids;
+  for (int e = 0; e < events; ++e)
+    ids.push_back(EventRegistry::instance().registerEvent("event " + std::to_string(e)));
+
+  double total = 0, fastest = 0, perEventTotal = 0, perEventFastest = 0;
+  for (int r = 0; r < repetitions; ++r) {
+    EventRegistry::instance().clear();
+    EventRegistry::instance().initialize("bench");
+    for (auto id : ids) {
+      for (int i = 0; i < instances; ++i) {
+        Event e(id);
+        e.addData("iterations", i);
+        e.addData("residual", 1.0 / (i + 1));
+      }
+    }
+
+    auto const slowest = measureSlowest([] { EventRegistry::instance().finalize(); });
+    total += slowest;
+    fastest = r == 0 ? slowest : std::min(fastest, slowest);
+
+    auto const perEvent = measureSlowest([=] { collectPerEvent(events, instances, MPI_COMM_WORLD); });
+    perEventTotal += perEvent;
+    perEventFastest = r == 0 ? perEvent : std::min(perEventFastest, perEvent);
+  }
+
+  if (rank == 0) {
+    Table table;
+    table.addColumn("Ranks", 6);
+    table.addColumn("Events", 6);
+    table.addColumn("Instances", 9);
+    table.addColumn("Finalize avg [ms]", 17, 4);
+    table.addColumn("Finalize min [ms]", 17, 4);
+    table.addColumn("Per-event avg [ms]", 18, 4);
+    table.addColumn("Per-event min [ms]", 18, 4);
+    table.printHeader();
+    table.printRow(size, events, instances, total / repetitions, fastest,
+                   perEventTotal / repetitions, perEventFastest);
+  }
+
+  MPI_Finalize();
+}
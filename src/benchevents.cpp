@@ -0,0 +1,83 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <mpi.h>
+#include "EventTimings/EventUtils.hpp"
+#include "TableWriter.hpp"
+
+using namespace EventTimings;
+
+/// Prevents the compiler from optimizing away the benchmark loops
+volatile int sink = 0;
+
+/// Runs f n times and returns the average duration of a call in nanoseconds
+template<typename F>
+double measure(int n, F f)
+{
+  auto const start = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; ++i)
+    f(i);
+  auto const stop = std::chrono::steady_clock::now();
+  EventRegistry::instance().clear();
+  return std::chrono::duration<double, std::nano>(stop - start).count() / n;
+}
+
+int main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+  EventRegistry::instance().initialize("bench");
+
+  int const n = 1000000;
+  auto const enabledID = EventRegistry::instance().registerEvent("enabled");
+  auto const disabledID = EventRegistry::instance().registerEvent("disabled", 1);
+  auto const aggregateID = EventRegistry::instance().registerEvent("aggregate");
+#ifndef EVENTTIMINGS_DISABLED
+  EventRegistry::instance().setRecording(aggregateID, Event::Recording::AGGREGATE);
+#endif
+
+#ifdef EVENTTIMINGS_DISABLED
+  std::cout << "Events are disabled at compile time" << std::endl;
+#endif
+
+  Table table;
+  table.addColumn("Benchmark", 20);
+  table.addColumn("ns / iteration", 14, 3);
+  table.addColumn("ns over empty loop", 18, 3);
+  table.printHeader();
+
+  auto const empty = measure(n, [](int i) {
+        sink = i;
+      });
+  table.printRow("Empty loop", empty, 0.0);
+
+  /// Prints a row with the duration and the difference to the empty loop
+  auto const printRow = [&table, empty](std::string const & name, double duration) {
+    table.printRow(name, duration, duration - empty);
+  };
+
+  printRow("Disabled level", measure(n, [disabledID](int i) {
+        Event e(disabledID);
+        sink = i;
+      }));
+  Event disabled(disabledID, false, false);
+  printRow("Disabled start/stop", measure(n, [&disabled](int i) {
+        disabled.start();
+        disabled.stop();
+        sink = i;
+      }));
+  printRow("Registered event", measure(n, [enabledID](int i) {
+        Event e(enabledID);
+        sink = i;
+      }));
+  printRow("Aggregate event", measure(n, [aggregateID](int i) {
+        Event e(aggregateID);
+        sink = i;
+      }));
+  printRow("Named event", measure(n, [](int i) {
+        Event e("named");
+        sink = i;
+      }));
+
+  EventRegistry::instance().finalize();
+  MPI_Finalize();
+}
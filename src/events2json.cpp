@@ -0,0 +1,33 @@
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include "EventTimings/TraceFile.hpp"
+
+using namespace EventTimings;
+
+/// Exports a binary trace file of Gather::SHARED_FILE or checkpoints to the JSON format of writeJSON
+int main(int argc, char *argv[])
+{
+  if (argc < 2 or argc > 3) {
+    std::cerr << "Usage: " << argv[0] << " TRACEFILE [JSONFILE]" << std::endl
+              << "Writes the JSON to standard output if no JSONFILE is given." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  try {
+    TraceFile const file(argv[1]);
+    if (argc == 3) {
+      std::ofstream out(argv[2]);
+      file.writeJSON(out);
+    }
+    else {
+      file.writeJSON(std::cout);
+    }
+  }
+  catch (std::exception const & e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "TraceConverter.hpp"
+#include "json.hpp"
+
+using namespace EventTimings;
+
+namespace {
+
+void printUsage(char const * program)
+{
+  std::cerr << "Usage: " << program << " [OPTION]... [--] PARTICIPANT=LOGFILE..." << std::endl
+            << "Assembles a trace in the Trace Event Format from the event logs of all participants." << std::endl
+            << "A LOGFILE is the JSON output or the index of Gather::FILES." << std::endl
+            << std::endl
+            << "  -o, --output FILE     Write the trace to FILE instead of standard output" << std::endl
+            << "  -d, --default NAME    Category of events without a mapping, default is 'default'" << std::endl
+            << "  -m, --mapping FILE    JSON object that maps event names to categories" << std::endl
+            << "  -g, --noglobal        Ignore the global event" << std::endl
+            << "  -k, --ranks RANK...   Only convert the given ranks" << std::endl
+            << "  -t, --maxtime NS      Maximum timestamp to convert, nanoseconds after init of the first rank" << std::endl
+            << "      --no-normalize    Disable the normalization of times among participants" << std::endl
+            << "  -j, --threads N       Number of threads converting files, default is the number of cores" << std::endl
+            << "  -h, --help            Print this help" << std::endl;
+}
+
+/// Returns whether s is a non-negative integer
+bool isNumber(char const * s)
+{
+  return *s and std::all_of(s, s + std::strlen(s), [](char c) { return c >= '0' and c <= '9'; });
+}
+
+}
+
+/// Converts event logs to the Trace Event Format, a replacement of events2trace.py
+int main(int argc, char *argv[])
+{
+  ConversionOptions options;
+  options.threads = std::max(1u, std::thread::hardware_concurrency());
+  std::string output;
+
+  try {
+    bool optionsDone = false;
+    for (int i = 1; i < argc; ++i) {
+      std::string const arg = argv[i];
+      auto const value = [&]() -> std::string {
+        if (i + 1 == argc)
+          throw std::invalid_argument("Missing value of " + arg);
+        return argv[++i];
+      };
+      if (optionsDone or arg.empty() or arg[0] != '-') {
+        auto const equals = arg.find('=');
+        if (equals == std::string::npos)
+          throw std::invalid_argument("Expected PARTICIPANT=LOGFILE instead of " + arg);
+        options.logs.emplace_back(arg.substr(0, equals), arg.substr(equals + 1));
+      }
+      else if (arg == "--")
+        optionsDone = true;
+      else if (arg == "-h" or arg == "--help") {
+        printUsage(argv[0]);
+        return EXIT_SUCCESS;
+      }
+      else if (arg == "-o" or arg == "--output")
+        output = value();
+      else if (arg == "-d" or arg == "--default")
+        options.defaultCategory = value();
+      else if (arg == "-m" or arg == "--mapping") {
+        auto const filename = value();
+        std::ifstream in(filename);
+        if (not in)
+          throw std::invalid_argument("Could not open " + filename);
+        options.mapping = nlohmann::json::parse(in).get<std::map<std::string, std::string>>();
+      }
+      else if (arg == "-g" or arg == "--noglobal")
+        options.noGlobal = true;
+      else if (arg == "-k" or arg == "--ranks") {
+        options.ranks.insert(std::stol(value()));
+        while (i + 1 < argc and isNumber(argv[i + 1]))
+          options.ranks.insert(std::stol(argv[++i]));
+      }
+      else if (arg == "-t" or arg == "--maxtime")
+        options.maxTime = std::stoll(value());
+      else if (arg == "--no-normalize")
+        options.normalize = false;
+      else if (arg == "-j" or arg == "--threads")
+        options.threads = std::max(1, std::stoi(value()));
+      else
+        throw std::invalid_argument("Unknown option " + arg);
+    }
+    if (options.logs.empty())
+      throw std::invalid_argument("No log files given");
+  }
+  catch (std::exception const & e) {
+    std::cerr << e.what() << std::endl;
+    printUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  try {
+    if (output.empty())
+      convertToTrace(options, std::cout);
+    else {
+      std::ofstream out(output);
+      if (not out)
+        throw std::runtime_error("Could not open " + output);
+      convertToTrace(options, out);
+    }
+  }
+  catch (std::exception const & e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <mpi.h>
+#include "EventTimings/EventUtils.hpp"
+
+using namespace EventTimings;
+
+/// Number of calls to the global operator new
+std::atomic<long> allocations{0};
+
+void * operator new(std::size_t size)
+{
+  ++allocations;
+  if (void * p = std::malloc(size))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void * p) noexcept
+{
+  std::free(p);
+}
+
+/// Starts and stops an event n times, returns the number of allocations made meanwhile
+long startStop(Event & e, int n)
+{
+  long const before = allocations;
+  for (int i = 0; i < n; ++i) {
+    e.start();
+    e.stop();
+  }
+  return allocations - before;
+}
+
+int main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+  EventRegistry::instance().initialize();
+
+  auto id = EventRegistry::instance().registerEvent("allocations");
+  Event e(id, false, false);
+
+  // Warm up: creates the shard of this thread, the EventData and the first chunk of the timeline
+  startStop(e, 1);
+
+  // Fills up the first chunk of the timeline, each start and stop adds one state change.
+  // The start of the global event and the warm up already took three state changes.
+  long const n = (Timeline::chunkSize - 3) / 2;
+  long const allocs = startStop(e, n);
+  std::cout << "Allocations for " << n << " starts and stops: " << allocs << std::endl;
+
+  // Cleared chunks are reused
+  EventRegistry::instance().clear();
+  startStop(e, 1);
+  long const reused = startStop(e, n);
+  std::cout << "Allocations after clear: " << reused << std::endl;
+
+  // Aggregated events record no state changes, hence never allocate chunks
+  auto aggregateID = EventRegistry::instance().registerEvent("aggregate");
+  EventRegistry::instance().setRecording(aggregateID, Event::Recording::AGGREGATE);
+  Event aggregate(aggregateID, false, false);
+  startStop(aggregate, 1);
+  long const aggregated = startStop(aggregate, 10 * Timeline::chunkSize);
+  std::cout << "Allocations for " << 10 * Timeline::chunkSize << " aggregated starts and stops: " << aggregated << std::endl;
+
+  EventRegistry::instance().finalize();
+  MPI_Finalize();
+
+  return (allocs == 0 and reused == 0 and aggregated == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,87 @@
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <mpi.h>
+#include "EventTimings/EventUtils.hpp"
+#include "json.hpp"
+
+using namespace EventTimings;
+
+/// Tests finalizeAsync while the application communicates in the meantime, run with any number of ranks.
+/** With the argument "funneled" MPI is initialized without MPI_THREAD_MULTIPLE, the finalization then
+ *  progresses in test and wait instead of a helper thread. */
+int main(int argc, char *argv[])
+{
+  bool const funneled = argc > 1 and std::string(argv[1]) == "funneled";
+  int provided;
+  MPI_Init_thread(&argc, &argv, funneled ? MPI_THREAD_FUNNELED : MPI_THREAD_MULTIPLE, &provided);
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  EventRegistry::instance().initialize("testasync");
+  for (int i = 0; i < 5; ++i)
+    Event e("async event");
+
+  EventRegistry::instance().finalizeAsync();
+
+  // The communicator of the registry is in use by the helper thread
+  bool success = false;
+  try {
+    EventRegistry::instance().getMPIComm();
+    std::cout << "The communicator is available during finalizeAsync" << std::endl;
+  }
+  catch (std::logic_error const &) {
+    success = true;
+  }
+
+  // An event with a barrier skips it in the meantime
+  {
+    Event e("barrier event", true);
+  }
+
+  // Collectives of the application must not interfere with those of the registry
+  int sum = 0;
+  for (int i = 0; i < 10; ++i) {
+    int one = 1;
+    MPI_Allreduce(&one, &sum, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    EventRegistry::instance().test();
+  }
+
+  EventRegistry::instance().wait();
+
+  if (not EventRegistry::instance().test()) {
+    std::cout << "The finalization is not complete after wait" << std::endl;
+    success = false;
+  }
+
+  if (EventRegistry::instance().getMPIComm() != MPI_COMM_WORLD) {
+    std::cout << "The communicator of initialize is not restored by wait" << std::endl;
+    success = false;
+  }
+  if (sum != size) {
+    std::cout << "Unexpected result of the application" << std::endl;
+    success = false;
+  }
+
+  if (rank == 0) {
+    std::stringstream out;
+    EventRegistry::instance().writeJSON(out);
+    auto const js = nlohmann::json::parse(out);
+    if (js["Ranks"].size() != static_cast<std::size_t>(size)) {
+      std::cout << "Expected " << size << " ranks" << std::endl;
+      success = false;
+    }
+    for (auto const & jRank : js["Ranks"]) {
+      if (jRank["Timings"]["async event"]["Count"] != 5 or jRank["StateChanges"].size() != 12) {
+        std::cout << "Unexpected data of a rank" << std::endl;
+        success = false;
+      }
+    }
+  }
+
+  MPI_Finalize();
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,86 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mpi.h>
+#include "EventTimings/EventUtils.hpp"
+#include "EventTimings/TraceFile.hpp"
+
+using namespace EventTimings;
+
+/// Tests checkpoints with and without an interval, run with any number of ranks
+int main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  EventRegistry::instance().setGather(EventRegistry::Gather::SHARED_FILE);
+  EventRegistry::instance().initialize("testcheckpoint");
+
+  bool success = true;
+
+  // Releasing a timeline frees its chunks
+  Timeline timeline;
+  for (std::size_t i = 0; i <= Timeline::chunkSize; ++i)
+    timeline.push({Event::State::STARTED, Event::Clock::now(), 0, 0});
+  timeline.clear();
+  timeline.push({Event::State::STARTED, Event::Clock::now(), 0, 0});
+  if (timeline.release() != 2 or not timeline.empty()) {
+    std::cout << "Unexpected chunks of a released timeline" << std::endl;
+    success = false;
+  }
+
+  // The interval has not elapsed, nothing is written
+  EventRegistry::instance().setCheckpointInterval(3600);
+  for (int i = 0; i < 3; ++i) {
+    Event e("checkpoint event");
+    e.stop();
+    EventRegistry::instance().checkpoint();
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+  if (rank == 0 and std::ifstream("testcheckpoint-events.bin")) {
+    std::cout << "Unexpected checkpoint within the interval" << std::endl;
+    success = false;
+  }
+
+  // Each checkpoint appends a segment, finalize the last one
+  EventRegistry::instance().setCheckpointInterval(0);
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 100; ++j)
+      Event e("checkpoint event");
+    EventRegistry::instance().checkpoint();
+  }
+  EventRegistry::instance().finalize();
+  EventRegistry::instance().printAll();
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  if (rank == 0) {
+    TraceFile const file("testcheckpoint-events.bin");
+    if (file.getSegments().size() != 4) {
+      std::cout << "Expected 4 segments, found " << file.getSegments().size() << std::endl;
+      success = false;
+    }
+
+    // The timings are cumulative, the state changes are spread over the segments
+    auto const & names = file.getNames();
+    auto const id = std::find(names.begin(), names.end(), "checkpoint event") - names.begin();
+    for (int r = 0; r < file.getRanks(); ++r) {
+      auto const data = file.load(r);
+      std::size_t stateChanges = 0;
+      for (auto const & segment : file.getSegments())
+        stateChanges += segment.sections[r].stateChanges.size();
+      if (data.evData[id].getCount() != 303 or data.stateChanges.size() != stateChanges
+          or stateChanges != 2 * 303 + 2) {
+        std::cout << "Unexpected data of rank " << r << std::endl;
+        success = false;
+      }
+    }
+    std::remove("testcheckpoint-events.bin");
+  }
+
+  MPI_Finalize();
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
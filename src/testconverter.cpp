@@ -0,0 +1,120 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include "TraceConverter.hpp"
+#include "json.hpp"
+
+using namespace EventTimings;
+using nlohmann::json;
+
+/// Returns a state change of the JSON output
+json stateChange(std::string const & name, int state, long long timestamp, int thread = 0)
+{
+  return {{"Name", name}, {"State", state}, {"Timestamp", timestamp}, {"Thread", thread}};
+}
+
+/// Returns a log of the JSON output
+json log(std::string const & initialized, json const & ranks)
+{
+  return {{"Finalized", initialized}, {"Initialized", initialized}, {"Name", ""}, {"Ranks", ranks}};
+}
+
+/// Converts with options and returns the complete and metadata events, counted by name, end events as "name end"
+std::map<std::string, int> convert(ConversionOptions options, json & trace)
+{
+  std::stringstream out;
+  convertToTrace(options, out);
+  trace = json::parse(out);
+  std::map<std::string, int> counts;
+  for (auto const & e : trace)
+    if (e["ph"] == "X" or e["ph"] == "M" or e["ph"] == "E")
+      counts[e["name"].get<std::string>() + (e["ph"] == "E" ? " end" : "")] += 1;
+  return counts;
+}
+
+/// Returns the first event of a name, an empty object if there is none
+json find(json const & trace, std::string const & name)
+{
+  for (auto const & e : trace)
+    if (e["name"] == name)
+      return e;
+  return json::object();
+}
+
+/// Tests the conversion of a log and an index of Gather::FILES into a trace
+int main()
+{
+  bool success = true;
+
+  if (parseTime("1970-01-02T00:00:01.5") != 86401500000000ll) {
+    std::cout << "Unexpected time" << std::endl;
+    success = false;
+  }
+
+  // Participant A has two ranks and a worker thread, B two files of one rank each, initialized 0.5 s earlier
+  json rankA0 = {{"Timings", {{"solve", {{"Count", 2}, {"Data", {{"x", {1, 2, 3}}}}}}}},
+                 {"StateChanges", {stateChange("_GLOBAL", 1, 0), stateChange("solve", 1, 1000),
+                                   stateChange("worker", 1, 2000, 1), stateChange("worker", 0, 2500, 1),
+                                   stateChange("solve", 0, 3000), stateChange("solve", 1, 4000),
+                                   stateChange("solve", 2, 5000), stateChange("_GLOBAL", 0, 10000)}}};
+  // A stop after a pause is skipped
+  json rankA1 = {{"StateChanges", {stateChange("solve", 1, 1000), stateChange("solve", 0, 2000),
+                                   stateChange("solve", 1, 3000), stateChange("solve", 2, 4000),
+                                   stateChange("solve", 0, 5000)}}};
+  std::ofstream("testconverter-A.json") << log("2020-01-01T00:00:01.000", {rankA0, rankA1});
+  for (int r = 0; r < 2; ++r) {
+    json rank = {{"StateChanges", {stateChange("couple", 1, 0), stateChange("couple", 0, 1000000)}}};
+    std::ofstream("testconverter-B." + std::to_string(r) + ".json")
+      << log("2020-01-01T00:00:00.500", json::array({rank}));
+  }
+  std::ofstream("testconverter-B.index.json") << json{{"Files", {"testconverter-B.0.json", "testconverter-B.1.json"}},
+                                                      {"Initialized", "2020-01-01T00:00:00.500"}};
+
+  ConversionOptions options;
+  options.logs = {{"A", "testconverter-A.json"}, {"B", "testconverter-B.index.json"}};
+  options.mapping = {{"solve", "solver"}};
+  options.threads = 2;
+
+  json trace;
+  auto counts = convert(options, trace);
+  if (counts["process_name"] != 2 or counts["thread_name"] != 5 or counts["_GLOBAL"] != 1
+      or counts["solve"] != 4 or counts["solve end"] != 0 or counts["worker"] != 1 or counts["couple"] != 2) {
+    std::cout << "Unexpected events " << trace << std::endl;
+    success = false;
+  }
+
+  // A is shifted by 0.5 s, its worker thread is a thread of its own
+  auto worker = find(trace, "worker");
+  if (worker["pid"] != 0 or worker["tid"] != 1 << 20 or worker["ts"] != 500002.0 or worker["dur"] != 0.5
+      or worker["cat"] != "default" or find(trace, "solve")["cat"] != "solver") {
+    std::cout << "Unexpected worker event " << worker << std::endl;
+    success = false;
+  }
+  auto couple = find(trace, "couple");
+  if (couple["pid"] != 1 or couple["ts"] != 0.0 or couple["dur"] != 1000.0) {
+    std::cout << "Unexpected couple event " << couple << std::endl;
+    success = false;
+  }
+
+  // Filters of ranks, time and the global event, without normalization
+  options.ranks = {1};
+  options.noGlobal = true;
+  options.normalize = false;
+  options.maxTime = 1500;
+  counts = convert(options, trace);
+  if (counts["thread_name"] != 2 or counts["solve"] != 0 or counts["couple"] != 0
+      or find(trace, "solve")["ph"] != "B" or find(trace, "couple")["tid"] != 1) {
+    std::cout << "Unexpected filtered events " << trace << std::endl;
+    success = false;
+  }
+
+  std::remove("testconverter-A.json");
+  std::remove("testconverter-B.0.json");
+  std::remove("testconverter-B.1.json");
+  std::remove("testconverter-B.index.json");
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
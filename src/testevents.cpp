@@ -1,8 +1,12 @@
+#include <cmath>
+#include <cstdint>
 #include <thread>
 #include <iostream>
 #include <random>
+#include <sstream>
 #include <mpi.h>
 #include "EventTimings/EventUtils.hpp"
+#include "json.hpp"
 
 using std::cout;
 using std::endl;
@@ -83,16 +87,120 @@ void testevents() {
   
 }
 
+void testthreads() {
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([t] {
+        ScopedEventPrefix sep("thread/");
+        for (int i = 0; i < 1000; ++i) {
+          Event e("work");
+          e.addData("thread", t);
+          e.addData("bytes", static_cast<std::int64_t>(i) << 32);
+          e.addData("residual", static_cast<double>(t));
+        }
+      });
+  }
+  for (auto & t : threads)
+    t.join();
+}
+
+/// Checks that threads registering the same names concurrently get the same handles
+bool testRegistration()
+{
+  std::vector<std::vector<EventID>> ids(4);
+  std::vector<std::thread> threads;
+  for (auto & threadIDs : ids)
+    threads.emplace_back([&threadIDs] {
+        for (int i = 0; i < 100; ++i)
+          threadIDs.push_back(EventRegistry::instance().registerEvent("registered " + std::to_string(i % 10)));
+      });
+  for (auto & t : threads)
+    t.join();
+
+  bool success = true;
+  for (auto const & threadIDs : ids)
+    for (int i = 0; i < 100; ++i)
+      success &= threadIDs[i] == ids[0][i % 10]
+        and EventRegistry::instance().getEventName(threadIDs[i]) == "registered " + std::to_string(i % 10);
+  if (not success)
+    cout << "Unexpected handles of concurrently registered names" << endl;
+  return success;
+}
+
+/// Checks the conversion of timestamps by two clock offsets to the reference clock
+bool testNormalization()
+{
+  using std::chrono::milliseconds;
+  RankData data;
+  data.initialize();
+
+  ClockOffset first, last;
+  first.at = Event::Clock::now();
+  first.offset = milliseconds(5);
+  last.at = first.at + std::chrono::seconds(2);
+  last.offset = milliseconds(7);
+
+  // The offset grows by 1 ms per second
+  auto const t0 = data.getInitializedAt(first);
+  auto const timestamp = first.at + std::chrono::seconds(1);
+  data.stateChanges.push({Event::State::STARTED, timestamp, 0, 0});
+  data.normalizeTo(t0, first, last);
+
+  auto const expected = timestamp + milliseconds(6) - t0.time_since_epoch();
+  bool const success = std::abs((data.stateChanges.begin()->timestamp - expected).count()) <= 1;
+  if (not success)
+    cout << "Unexpected normalized timestamp" << endl;
+  return success;
+}
+
 int main(int argc, char *argv[])
 {
   MPI_Init(&argc, &argv);
   EventRegistry::instance().initialize();
+  EventRegistry::instance().setSummaryOnly("residual");
 
   // testevents();
 
   Event("Anothertestevent");
+
+  auto id = EventRegistry::instance().registerEvent("Registered event");
+  for (int i = 0; i < 3; ++i)
+    Event e(id);
+
+  testthreads();
+
+  // Deep prefix hierarchies give names longer than 255 characters
+  std::string const longPrefix(200, 'p');
+  {
+    ScopedEventPrefix outer(longPrefix + "/");
+    ScopedEventPrefix inner(longPrefix + "/");
+    Event e("deep");
+  }
   
   EventRegistry::instance().finalize();
   EventRegistry::instance().printAll();
+
+  // Each thread attached one value per key to each of its events, residual is summary-only
+  bool success = true;
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  if (rank == 0) {
+    std::stringstream ss;
+    EventRegistry::instance().writeJSON(ss);
+    auto js = nlohmann::json::parse(ss);
+    for (auto const & jRank : js["Ranks"]) {
+      auto const & jData = jRank["Timings"]["thread/work"]["Data"];
+      success &= jData["thread"].size() == 4000;
+      success &= jData["bytes"].size() == 4000 and jData["bytes"][999] == 999L << 32;
+      success &= jData["residual"]["Count"] == 4000;
+      success &= std::abs(jData["residual"]["Mean"].get<double>() - 1.5) < 1e-12;
+      success &= std::abs(jData["residual"]["Variance"].get<double>() - 1.25) < 1e-12;
+      success &= jRank["Timings"].count(longPrefix + "/" + longPrefix + "/deep") == 1;
+    }
+  }
+  success &= testNormalization();
+  success &= testRegistration();
+
   MPI_Finalize();
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,57 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <mpi.h>
+#include "EventTimings/EventUtils.hpp"
+#include "json.hpp"
+
+using namespace EventTimings;
+
+/// Tests the output of a file per rank, including state changes written to disk, run with any number of ranks
+int main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  EventRegistry::instance().setGather(EventRegistry::Gather::FILES);
+  EventRegistry::instance().setTraceBudget(1);
+  EventRegistry::instance().initialize("testfiles");
+
+  int const n = 2 * Timeline::chunkSize;
+  for (int i = 0; i < n; ++i)
+    Event e("file event");
+
+  EventRegistry::instance().finalize();
+  EventRegistry::instance().printAll();
+
+  bool success = true;
+  std::string const file = "testfiles-events." + std::to_string(rank) + ".json";
+  auto const js = nlohmann::json::parse(std::ifstream(file));
+  auto const & jRank = js["Ranks"][0];
+  if (jRank["Timings"]["file event"]["Count"] != n or jRank["StateChanges"].size() != 2 * n + 2) {
+    std::cout << "Unexpected content of " << file << std::endl;
+    success = false;
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  if (rank == 0) {
+    auto const index = nlohmann::json::parse(std::ifstream("testfiles-events.index.json"));
+    if (index["Files"].size() != static_cast<std::size_t>(size)) {
+      std::cout << "Expected " << size << " files in the index" << std::endl;
+      success = false;
+    }
+    if (std::ifstream("testfiles-events.json")) {
+      std::cout << "Unexpected gathered output" << std::endl;
+      success = false;
+    }
+    std::remove("testfiles-events.index.json");
+  }
+  std::remove(file.c_str());
+
+  MPI_Finalize();
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,50 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include "EventTimings/Histogram.hpp"
+
+using namespace EventTimings;
+
+int failures = 0;
+
+void check(bool condition, std::string const & message)
+{
+  if (not condition) {
+    std::cout << "Failed: " << message << std::endl;
+    ++failures;
+  }
+}
+
+int main()
+{
+  // Every value lies within the bounds of its bucket
+  for (long value = 0; value < (1l << 40); value = value * 3 / 2 + 1) {
+    int const index = Histogram::getBucketIndex(value);
+    check(Histogram::getBucketLowerBound(index) <= value and value < Histogram::getBucketUpperBound(index),
+          "bounds of bucket " + std::to_string(index) + " for " + std::to_string(value));
+  }
+  check(Histogram::getBucketIndex(1l << 62) == Histogram::buckets - 1, "large values go to the last bucket");
+
+  // Percentiles of two merged halves of 1..100000 are within the relative error
+  Histogram lower, upper;
+  for (long value = 1; value <= 100000; ++value)
+    (value <= 50000 ? lower : upper).add(value);
+  lower.merge(upper);
+  check(lower.getCount() == 100000, "count after merge");
+  for (double p : {1.0, 50.0, 95.0, 99.0, 100.0}) {
+    double const expected = p * 1000;
+    double const error = std::abs(lower.getPercentile(p) - expected) / expected;
+    std::cout << "P" << p << " = " << lower.getPercentile(p) << ", relative error " << error << std::endl;
+    check(error < 1.0 / Histogram::subBuckets, "percentile " + std::to_string(p));
+  }
+
+  // Buckets can be restored
+  Histogram restored;
+  for (auto const & bucket : lower.getBuckets())
+    restored.add(bucket.first, bucket.second);
+  check(restored.getPercentile(99) == lower.getPercentile(99), "restored from buckets");
+
+  check(Histogram().getPercentile(50) == 0, "empty histogram");
+
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,202 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <mpi.h>
+#include "EventTimings/EventUtils.hpp"
+#include "json.hpp"
+
+using namespace EventTimings;
+
+/// The fields of a protobuf message, varints and length-delimited fields in the order of the message
+struct Message
+{
+  std::multimap<std::uint32_t, std::uint64_t> varints;
+  std::multimap<std::uint32_t, std::string> bytes;
+
+  std::uint64_t varint(std::uint32_t field) const
+  {
+    auto const it = varints.find(field);
+    return it == varints.end() ? 0 : it->second;
+  }
+
+  /// Returns the first nested message of a field, an empty message if there is none
+  Message message(std::uint32_t field) const;
+};
+
+/// Decodes the varint at pos and advances pos
+std::uint64_t decodeVarint(std::string const & data, std::size_t & pos)
+{
+  std::uint64_t value = 0;
+  for (int shift = 0; pos < data.size(); shift += 7) {
+    auto const byte = static_cast<unsigned char>(data[pos++]);
+    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if (byte < 0x80)
+      return value;
+  }
+  throw std::runtime_error("Truncated varint");
+}
+
+/// Decodes a message of varint and length-delimited fields
+Message decode(std::string const & data)
+{
+  Message m;
+  std::size_t pos = 0;
+  while (pos < data.size()) {
+    auto const key = decodeVarint(data, pos);
+    auto const field = static_cast<std::uint32_t>(key >> 3);
+    if ((key & 7) == 0)
+      m.varints.emplace(field, decodeVarint(data, pos));
+    else if ((key & 7) == 2) {
+      auto const size = decodeVarint(data, pos);
+      if (pos + size > data.size())
+        throw std::runtime_error("Truncated field");
+      m.bytes.emplace(field, data.substr(pos, size));
+      pos += size;
+    }
+    else
+      throw std::runtime_error("Unexpected wire type");
+  }
+  return m;
+}
+
+Message Message::message(std::uint32_t field) const
+{
+  auto const it = bytes.find(field);
+  return it == bytes.end() ? Message() : decode(it->second);
+}
+
+/// Tests the Perfetto trace against the Trace Event Format, run with any number of ranks
+int main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  EventRegistry::instance().setTraceFormat(EventRegistry::TraceFormat::PERFETTO);
+  EventRegistry::instance().initialize("testperfetto");
+
+  for (int i = 0; i < 3; ++i) {
+    Event outer("outer");
+    Event inner("inner");
+    inner.stop();
+    Event paused("paused");
+    paused.pause();
+    paused.start();
+    Event pausedStopped("paused stopped");
+    pausedStopped.pause();
+    pausedStopped.stop();
+  }
+  std::thread worker([] { Event e("worker"); });
+  worker.join();
+
+  EventRegistry::instance().finalize();
+  EventRegistry::instance().printAll();
+
+  bool success = true;
+  if (rank == 0) {
+    std::ifstream file("testperfetto-events.pftrace", std::ios::binary);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    auto const trace = decode(buffer.str());
+
+    // The begins and durations of slices in microseconds by tid and name, decoded per sequence.
+    // An end closes the last open slice of the track.
+    struct Sequence
+    {
+      std::uint64_t timestamp = 0;
+      long tid = -1;
+      std::map<std::uint64_t, std::string> names;
+      std::vector<std::pair<std::string, std::uint64_t>> open;
+    };
+    std::map<std::uint64_t, Sequence> sequences;
+    std::map<std::pair<long, std::string>, std::multiset<std::pair<double, double>>> slices;
+    std::set<std::string> processes, threads;
+    int ends = 0;
+    for (auto const & p : trace.bytes) {
+      auto const packet = decode(p.second);
+      auto const track = packet.message(60);
+      if (track.bytes.count(3))
+        processes.insert(track.message(3).bytes.find(6)->second);
+      if (packet.varints.count(10) == 0)
+        continue;
+
+      auto & sequence = sequences[packet.varint(10)];
+      if (packet.varint(13) & 1)
+        sequence = Sequence();
+      else
+        sequence.timestamp += packet.varint(8);
+      if (track.bytes.count(4)) {
+        sequence.tid = track.message(4).varint(2);
+        threads.insert(track.message(4).bytes.find(5)->second);
+      }
+      for (auto const & n : packet.message(12).bytes) {
+        auto const name = decode(n.second);
+        sequence.names[name.varint(1)] = name.bytes.find(2)->second;
+      }
+      auto const event = packet.message(11);
+      if (event.varint(9) == 1)
+        sequence.open.emplace_back(sequence.names.at(event.varint(10)), sequence.timestamp);
+      else if (event.varint(9) == 2) {
+        ++ends;
+        if (sequence.open.empty()) {
+          std::cout << "Slice end without a begin on tid " << sequence.tid << std::endl;
+          success = false;
+          continue;
+        }
+        auto const & begin = sequence.open.back();
+        slices[{sequence.tid, begin.first}].emplace(begin.second / 1e3, (sequence.timestamp - begin.second) / 1e3);
+        sequence.open.pop_back();
+      }
+    }
+
+    // The complete events of writeTrace are the same slices
+    std::stringstream out;
+    EventRegistry::instance().writeTrace(out);
+    auto const json = nlohmann::json::parse(out);
+    int completes = 0;
+    for (auto const & e : json["traceEvents"]) {
+      if (e["ph"] != "X")
+        continue;
+      ++completes;
+      auto const it = slices.find({e["tid"].get<long>(), e["name"].get<std::string>()});
+      auto const slice = std::make_pair(e["ts"].get<double>(), e["dur"].get<double>());
+      if (it == slices.end() or it->second.count(slice) == 0) {
+        std::cout << "No slice of " << e << std::endl;
+        success = false;
+      }
+      else
+        it->second.erase(it->second.find(slice));
+    }
+
+    std::size_t unmatched = 0;
+    for (auto const & s : slices)
+      unmatched += s.second.size();
+    if (unmatched != 0 or ends != completes or completes != size * (2 + 3 * 5)) {
+      std::cout << "Unexpected " << unmatched << " unmatched slices and " << ends << " ends" << std::endl;
+      success = false;
+    }
+    // The sequences of all threads are numbered from 1 on
+    if (processes != std::set<std::string>{"testperfetto"} or threads.size() != 2u * size
+        or sequences.size() != 2u * size or sequences.begin()->first != 1
+        or sequences.rbegin()->first != sequences.size()) {
+      std::cout << "Unexpected tracks" << std::endl;
+      success = false;
+    }
+    std::remove("testperfetto-events.json");
+    std::remove("testperfetto-events.pftrace");
+  }
+
+  MPI_Finalize();
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
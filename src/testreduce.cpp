@@ -0,0 +1,84 @@
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <mpi.h>
+#include "EventTimings/EventUtils.hpp"
+#include "json.hpp"
+
+using namespace EventTimings;
+
+/// Returns the line of the summary that contains name, or an empty string
+std::string findLine(std::string const & summary, std::string const & name)
+{
+  std::istringstream in(summary);
+  std::string line;
+  while (std::getline(in, line))
+    if (line.find(name) != std::string::npos)
+      return line;
+  return "";
+}
+
+/// Tests the global statistics and the data gathered per node, run with any number of ranks on one node
+int main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  EventRegistry::instance().setGather(EventRegistry::Gather::NODES);
+  EventRegistry::instance().initialize("testreduce");
+  EventRegistry::instance().setSummaryOnly("value");
+
+  // Only rank 0 does not know the name of this event, it needs to be sent
+  if (rank > 0) {
+    for (int i = 0; i < 7; ++i) {
+      Event e("not on rank 0");
+      e.addData("value", rank);
+    }
+  }
+
+  EventRegistry::instance().finalize();
+
+  bool success = true;
+  if (rank == 0) {
+    std::stringstream ss;
+    EventRegistry::instance().writeSummary(ss);
+    std::cout << ss.str();
+
+    auto const line = findLine(ss.str(), "not on rank 0");
+    if (size > 1 and line.find(" " + std::to_string(7 * (size - 1)) + " ") == std::string::npos) {
+      std::cout << "Expected a count of " << 7 * (size - 1) << " for \"not on rank 0\"" << std::endl;
+      success = false;
+    }
+    if (size == 1 and not line.empty()) {
+      std::cout << "Unexpected \"not on rank 0\"" << std::endl;
+      success = false;
+    }
+
+    // The summaries of the data are reduced as well, the maximum value is the last rank
+    auto const dataLine = findLine(ss.str(), "value");
+    if (size > 1 and dataLine.find(" " + std::to_string(size - 1) + " ") == std::string::npos) {
+      std::cout << "Expected a maximum of " << size - 1 << " for \"value\"" << std::endl;
+      success = false;
+    }
+
+    // All ranks are on one node, their data is merged, but without state changes
+    std::stringstream js;
+    EventRegistry::instance().writeJSON(js);
+    auto const ranks = nlohmann::json::parse(js)["Ranks"];
+    if (ranks.size() != 1 or not ranks[0]["StateChanges"].empty()) {
+      std::cout << "Expected a single node without state changes" << std::endl;
+      success = false;
+    }
+    else if (ranks[0]["Timings"]["_GLOBAL"]["Count"] != size or
+             (size > 1 and ranks[0]["Timings"]["not on rank 0"]["Data"]["value"]["Count"] != 7 * (size - 1))) {
+      std::cout << "Expected the merged data of all ranks" << std::endl;
+      success = false;
+    }
+  }
+
+  MPI_Finalize();
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,168 @@
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <mpi.h>
+#include "EventTimings/EventUtils.hpp"
+#include "json.hpp"
+
+using namespace EventTimings;
+using nlohmann::json;
+
+/// Validates values against the subset of JSON Schema draft-07 used by docs/Events.schema.json
+class SchemaValidator
+{
+public:
+  /// quiet suppresses the printing of errors, e.g., for options of oneOf
+  explicit SchemaValidator(json const & root, bool quiet = false)
+    : root(root), quiet(quiet)
+  {}
+
+  /// Returns whether value is valid, prints the path of the first error otherwise
+  bool validate(json const & value, json const & schema, std::string const & path = "$") const
+  {
+    if (schema.count("$ref")) {
+      // Only references to the definitions of the root are supported
+      auto const ref = schema["$ref"].get<std::string>();
+      return validate(value, root["definitions"][ref.substr(ref.rfind('/') + 1)], path);
+    }
+
+    if (schema.count("oneOf")) {
+      int matches = 0;
+      for (auto const & option : schema["oneOf"])
+        matches += SchemaValidator(root, true).validate(value, option, path);
+      if (matches != 1)
+        return fail(path, std::to_string(matches) + " options of oneOf match");
+    }
+
+    if (schema.count("type") and not hasType(value, schema["type"].get<std::string>()))
+      return fail(path, "is not of type " + schema["type"].get<std::string>());
+
+    if (schema.count("minimum") and value.is_number() and value.get<double>() < schema["minimum"].get<double>())
+      return fail(path, "is below the minimum");
+
+    if (schema.count("format") and schema["format"] == "date-time"
+        and not std::regex_match(value.get<std::string>(), std::regex(R"(\d{4}-\d\d-\d\dT\d\d:\d\d:\d\d(\.\d+)?)")))
+      return fail(path, "is not a date-time");
+
+    if (value.is_object()) {
+      if (schema.count("required"))
+        for (auto const & key : schema["required"])
+          if (not value.count(key.get<std::string>()))
+            return fail(path, "lacks the required " + key.get<std::string>());
+      for (auto it = value.begin(); it != value.end(); ++it) {
+        auto const child = path + "." + it.key();
+        if (schema.count("properties") and schema["properties"].count(it.key())) {
+          if (not validate(it.value(), schema["properties"][it.key()], child))
+            return false;
+        }
+        else if (schema.count("additionalProperties")) {
+          auto const & additional = schema["additionalProperties"];
+          if (additional.is_boolean() and not additional.get<bool>())
+            return fail(child, "is not allowed");
+          if (additional.is_object() and not validate(it.value(), additional, child))
+            return false;
+        }
+      }
+    }
+
+    if (value.is_array() and schema.count("items"))
+      for (std::size_t i = 0; i < value.size(); ++i)
+        if (not validate(value[i], schema["items"], path + "[" + std::to_string(i) + "]"))
+          return false;
+
+    return true;
+  }
+
+private:
+  static bool hasType(json const & value, std::string const & type)
+  {
+    if (type == "object")
+      return value.is_object();
+    if (type == "array")
+      return value.is_array();
+    if (type == "string")
+      return value.is_string();
+    if (type == "integer")
+      return value.is_number_integer();
+    if (type == "number")
+      return value.is_number();
+    return false;
+  }
+
+  bool fail(std::string const & path, std::string const & message) const
+  {
+    if (not quiet)
+      std::cout << path << " " << message << std::endl;
+    return false;
+  }
+
+  json const & root;
+
+  bool const quiet;
+};
+
+/// Validates the JSON output of a run with data, histograms and state changes against the schema,
+/// run with any number of ranks and the path of docs/Events.schema.json as argument
+int main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  EventRegistry::instance().setSummaryOnly("summary");
+  EventRegistry::instance().initialize("testschema", "schema run");
+  for (int i = 0; i < 10; ++i) {
+    Event e("data event");
+    e.addData("int", i);
+    e.addData("int64", static_cast<std::int64_t>(i) << 40);
+    e.addData("double", i / 3.0);
+    e.addData("summary", i * 1.5);
+    Event paused("paused event");
+    paused.pause();
+    paused.start();
+  }
+  std::thread worker([] { Event e("worker event"); });
+  worker.join();
+  EventRegistry::instance().finalize();
+
+  bool success = true;
+  if (rank == 0) {
+    std::ifstream schemaFile(argc > 1 ? argv[1] : "docs/Events.schema.json");
+    if (not schemaFile) {
+      std::cout << "Could not open the schema" << std::endl;
+      success = false;
+    }
+    else {
+      auto const schema = json::parse(schemaFile);
+      SchemaValidator const validator(schema);
+
+      std::stringstream out;
+      EventRegistry::instance().writeJSON(out);
+      auto output = json::parse(out);
+      auto const & timing = output["Ranks"][0]["Timings"]["data event"];
+      if (timing["Data"]["summary"]["Count"] != 10 or timing["Data"]["double"].size() != 10
+          or output["Ranks"][0]["StateChanges"].empty()) {
+        std::cout << "Unexpected output " << timing << std::endl;
+        success = false;
+      }
+      if (not validator.validate(output, schema))
+        success = false;
+
+      // The validator detects violations
+      output["Ranks"][0]["Unknown"] = 1;
+      output["Ranks"][0]["Timings"]["data event"].erase("Percentiles");
+      if (SchemaValidator(schema, true).validate(output["Ranks"][0], schema["definitions"]["Rank"])) {
+        std::cout << "Invalid output passed the validation" << std::endl;
+        success = false;
+      }
+    }
+  }
+
+  MPI_Finalize();
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <mpi.h>
+#include "EventTimings/EventUtils.hpp"
+#include "EventTimings/TraceFile.hpp"
+#include "json.hpp"
+
+using namespace EventTimings;
+
+/// Tests the collectively written binary file, including state changes written to disk, run with any number of ranks
+int main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  EventRegistry::instance().setGather(EventRegistry::Gather::SHARED_FILE);
+  EventRegistry::instance().setTraceBudget(1);
+  EventRegistry::instance().initialize("testsharedfile", "shared run");
+
+  // Ranks write sections of different sizes
+  int const n = (rank + 1) * Timeline::chunkSize;
+  for (int i = 0; i < n; ++i)
+    Event e("shared event");
+  if (rank == size - 1)
+    Event e("last rank event");
+
+  EventRegistry::instance().finalize();
+  EventRegistry::instance().printAll();
+
+  bool success = true;
+  MPI_Barrier(MPI_COMM_WORLD);
+  if (rank == 0) {
+    TraceFile const file("testsharedfile-events.bin");
+    auto const & segments = file.getSegments();
+    auto const registered = EventRegistry::instance().getEventNames().size();
+    if (segments.size() != 1 or file.getRanks() != size or segments[0].runName != "shared run") {
+      std::cout << "Unexpected header" << std::endl;
+      success = false;
+    }
+    auto const & names = segments[0].names;
+    if (std::count(names.begin(), names.end(), "shared event") != 1
+        or std::count(names.begin(), names.end(), "last rank event") != 1) {
+      std::cout << "Unexpected name table" << std::endl;
+      success = false;
+    }
+
+    // Each rank has its events and state changes, including those written to disk
+    for (int r = 0; r < file.getRanks(); ++r) {
+      auto const & section = segments[0].sections[r];
+      auto const expected = 2 * (r + 1) * Timeline::chunkSize + (r == size - 1 ? 4 : 2);
+      if (section.initializedAt > section.finalizedAt or section.stateChanges.size() != expected) {
+        std::cout << "Unexpected section of rank " << r << std::endl;
+        success = false;
+      }
+      std::size_t started = 0;
+      for (auto const sc : section.stateChanges)
+        started += names[sc.id] == "shared event" and sc.state == Event::State::STARTED;
+      auto const data = file.load(r);
+      auto const id = std::find(file.getNames().begin(), file.getNames().end(), "shared event") - file.getNames().begin();
+      if (started != (r + 1) * Timeline::chunkSize or data.evData[id].getCount() != static_cast<long>(started)
+          or data.stateChanges.size() != expected) {
+        std::cout << "Unexpected data of rank " << r << std::endl;
+        success = false;
+      }
+    }
+
+    // The JSON export holds the same
+    std::stringstream json;
+    file.writeJSON(json);
+    auto const js = nlohmann::json::parse(json);
+    if (js["Name"] != "shared run" or js["Ranks"].size() != static_cast<std::size_t>(size)
+        or js["Ranks"][0]["Timings"]["shared event"]["Count"] != Timeline::chunkSize) {
+      std::cout << "Unexpected JSON export" << std::endl;
+      success = false;
+    }
+
+    // Reading the file registers no names
+    if (EventRegistry::instance().getEventNames().size() != registered) {
+      std::cout << "Names registered by the TraceFile" << std::endl;
+      success = false;
+    }
+
+    // Corrupt files throw instead of reading out of bounds or allocating the corrupt sizes
+    std::ifstream in("testsharedfile-events.bin", std::ios::binary);
+    std::string const bytes{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    auto const throws = [](std::string const & content, int loadRank) {
+      std::ofstream("testsharedfile-corrupt.bin", std::ios::binary) << content;
+      try {
+        TraceFile const corrupt("testsharedfile-corrupt.bin");
+        corrupt.load(loadRank);
+      }
+      catch (std::runtime_error const &) {
+        return true;
+      }
+      return false;
+    };
+    // The number of names follows magic, version, ranks and the run name
+    auto hugeNames = bytes;
+    std::fill_n(hugeNames.begin() + 8 + 4 + 8 + 8 + 10, sizeof(std::size_t), '\xff');
+    // The id of the last state change of the last rank, which is unpacked by load
+    auto invalidID = bytes;
+    std::fill_n(invalidID.end() - 12, 4, '\x7f');
+    if (not throws(bytes.substr(0, 45), 0) or not throws(hugeNames, 0) or not throws(invalidID, size - 1)) {
+      std::cout << "Corrupt file did not throw" << std::endl;
+      success = false;
+    }
+    std::remove("testsharedfile-corrupt.bin");
+
+    if (std::ifstream("testsharedfile-events.json")) {
+      std::cout << "Unexpected gathered output" << std::endl;
+      success = false;
+    }
+    std::remove("testsharedfile-events.bin");
+  }
+
+  MPI_Finalize();
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,80 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <mpi.h>
+#include "EventTimings/EventUtils.hpp"
+#include "json.hpp"
+
+using namespace EventTimings;
+
+int main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  // Allows two chunks in memory, all further state changes are written to disk
+  EventRegistry::instance().setTraceBudget(2 * Timeline::chunkSize * sizeof(Event::StateChange) + 64);
+  EventRegistry::instance().initialize("testspill");
+
+  int const threads = 3;
+  int const n = 5 * Timeline::chunkSize;
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([] {
+        auto id = EventRegistry::instance().registerEvent("spilled");
+        for (int i = 0; i < n; ++i)
+          Event e(id);
+      });
+  }
+  for (auto & t : workers)
+    t.join();
+
+  bool success = true;
+  std::string const spillFile = "testspill-events." + std::to_string(rank) + ".spill";
+  if (not std::ifstream(spillFile)) {
+    std::cout << "Spill file " << spillFile << " has not been created" << std::endl;
+    success = false;
+  }
+
+  EventRegistry::instance().finalize();
+
+  if (std::ifstream(spillFile)) {
+    std::cout << "Spill file " << spillFile << " has not been removed" << std::endl;
+    success = false;
+  }
+
+  if (rank == 0) {
+    std::stringstream ss;
+    EventRegistry::instance().writeJSON(ss);
+    auto js = nlohmann::json::parse(ss);
+    for (auto const & jRank : js["Ranks"]) {
+      // Each thread starts and stops n events, the global event is started and stopped once
+      std::size_t const expected = 2 * threads * n + 2;
+      if (jRank["StateChanges"].size() != expected) {
+        std::cout << "Expected " << expected << " state changes, got " << jRank["StateChanges"].size() << std::endl;
+        success = false;
+      }
+
+      // The state changes of each thread keep their order
+      std::map<int, long> last;
+      for (auto const & sc : jRank["StateChanges"]) {
+        long const timestamp = sc["Timestamp"];
+        int const thread = sc["Thread"];
+        if (timestamp < last[thread]) {
+          std::cout << "State changes of thread " << thread << " are out of order" << std::endl;
+          success = false;
+          break;
+        }
+        last[thread] = timestamp;
+      }
+    }
+  }
+
+  MPI_Finalize();
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,98 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <mpi.h>
+#include "EventTimings/EventUtils.hpp"
+#include "json.hpp"
+
+using namespace EventTimings;
+
+/// Tests the output in the Trace Event Format, run with any number of ranks
+int main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  EventRegistry::instance().setTraceFormat(EventRegistry::TraceFormat::CHROME);
+  EventRegistry::instance().initialize("testtrace");
+
+  {
+    Event outer("outer");
+    Event inner("inner");
+    inner.stop();
+    Event paused("paused");
+    paused.pause();
+    paused.start();
+    Event pausedStopped("paused stopped");
+    pausedStopped.pause();
+    pausedStopped.stop();
+  }
+  std::thread worker([] { Event e("worker"); });
+  worker.join();
+
+  EventRegistry::instance().finalize();
+  EventRegistry::instance().printAll();
+
+  bool success = true;
+  if (rank == 0) {
+    auto const js = nlohmann::json::parse(std::ifstream("testtrace-events.trace.json"));
+    std::map<std::string, int> complete, names;
+    std::map<int, double> outerBegin, outerEnd;
+    for (auto const & e : js["traceEvents"]) {
+      std::string const name = e["name"], ph = e["ph"];
+      int const tid = e["tid"];
+      if (ph == "M") {
+        names[name] += 1;
+        continue;
+      }
+      if (ph != "X" or e["dur"] < 0) {
+        std::cout << "Unexpected event " << e << std::endl;
+        success = false;
+        continue;
+      }
+      complete[name] += 1;
+
+      // The main thread of rank r has the tid r, its worker r + 2^20, as in the output of events2trace
+      if (tid % (1 << 20) >= size or tid >> 20 != (name == "worker")) {
+        std::cout << "Unexpected thread of " << e << std::endl;
+        success = false;
+      }
+      if (name == "outer") {
+        outerBegin[tid] = e["ts"];
+        outerEnd[tid] = e["ts"].get<double>() + e["dur"].get<double>();
+      }
+    }
+    for (auto const & e : js["traceEvents"]) {
+      if (e["name"] == "inner" and (e["ts"] < outerBegin[e["tid"]]
+                                    or e["ts"].get<double>() + e["dur"].get<double>() > outerEnd[e["tid"]])) {
+        std::cout << "Inner event not within outer event " << e << std::endl;
+        success = false;
+      }
+    }
+
+    if (complete["outer"] != size or complete["inner"] != size or complete["paused"] != 2 * size
+        or complete["paused stopped"] != size or complete["worker"] != size or complete["_GLOBAL"] != size) {
+      std::cout << "Unexpected number of complete events" << std::endl;
+      success = false;
+    }
+    if (names["process_name"] != 1 or names["thread_name"] != 2 * size) {
+      std::cout << "Unexpected metadata" << std::endl;
+      success = false;
+    }
+    if (js["otherData"]["Name"] != EventRegistry::instance().runName) {
+      std::cout << "Unexpected run name" << std::endl;
+      success = false;
+    }
+    std::remove("testtrace-events.json");
+    std::remove("testtrace-events.trace.json");
+  }
+
+  MPI_Finalize();
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}